@@ -35,6 +35,21 @@
 // gUnlockMutex(&m);
 // ...
 // gDestroyMutex(&m);
+//
+// GooCond c;
+// gInitCond(&c);
+// ...
+// gLockMutex(&m);
+//   while (!condition) gCondWait(&c, &m);
+// gUnlockMutex(&m);
+// ...
+// gCondBroadcast(&c);
+// ...
+// gDestroyCond(&c);
+//
+// gMemoryBarrier() keeps the memory accesses before it from being
+// reordered with the ones after it, for data that is read without the
+// lock.
 
 #ifdef _WIN32
 
@@ -47,6 +62,15 @@ typedef CRITICAL_SECTION GooMutex;
 #define gLockMutex(m) EnterCriticalSection(m)
 #define gUnlockMutex(m) LeaveCriticalSection(m)
 
+typedef CONDITION_VARIABLE GooCond;
+
+#define gInitCond(c) InitializeConditionVariable(c)
+#define gDestroyCond(c)
+#define gCondWait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define gCondBroadcast(c) WakeAllConditionVariable(c)
+
+#define gMemoryBarrier() MemoryBarrier()
+
 #else // assume pthreads
 
 #include <pthread.h>
@@ -58,6 +82,15 @@ typedef pthread_mutex_t GooMutex;
 #define gLockMutex(m) pthread_mutex_lock(m)
 #define gUnlockMutex(m) pthread_mutex_unlock(m)
 
+typedef pthread_cond_t GooCond;
+
+#define gInitCond(c) pthread_cond_init(c, NULL)
+#define gDestroyCond(c) pthread_cond_destroy(c)
+#define gCondWait(c, m) pthread_cond_wait(c, m)
+#define gCondBroadcast(c) pthread_cond_broadcast(c)
+
+#define gMemoryBarrier() __sync_synchronize()
+
 #endif
 
 #endif
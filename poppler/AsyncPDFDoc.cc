@@ -0,0 +1,245 @@
+//========================================================================
+//
+// AsyncPDFDoc.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "AsyncPDFDoc.h"
+
+#ifdef ENABLE_LIBCURL
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "Error.h"
+#include "ErrorCodes.h"
+#include "Object.h"
+#include "Stream.h"
+#include "Catalog.h"
+#include "Page.h"
+#include "CurlCache.h"
+
+//------------------------------------------------------------------------
+// AsyncPDFDoc
+//------------------------------------------------------------------------
+
+AsyncPDFDoc::AsyncPDFDoc(GooString *urlA, AsyncPDFDocCbk cbkA,
+			 void *cbkDataA) {
+  url = urlA;
+  cbk = cbkA;
+  cbkData = cbkDataA;
+  doc = NULL;
+  failed = gFalse;
+  errCode = errNone;
+  openAttempts = 0;
+  openErrors = 0;
+  pendingPages = NULL;
+  pageAttempts = NULL;
+  pageErrors = NULL;
+  nPendingPages = pendingPagesSize = 0;
+
+  cc = new CurlCache(url, gFalse);
+  cc->setDataCallback(&AsyncPDFDoc::dataAvailable, this);
+}
+
+AsyncPDFDoc::~AsyncPDFDoc() {
+  // the document's stream reads from the cache
+  delete doc;
+  delete cc;
+  delete url;
+  gfree(pendingPages);
+  gfree(pageAttempts);
+  gfree(pageErrors);
+}
+
+void AsyncPDFDoc::loadPage(int page) {
+  if (nPendingPages == pendingPagesSize) {
+    pendingPagesSize = pendingPagesSize ? 2 * pendingPagesSize : 8;
+    pendingPages = (int *)greallocn(pendingPages, pendingPagesSize,
+				    sizeof(int));
+    pageAttempts = (int *)greallocn(pageAttempts, pendingPagesSize,
+				    sizeof(int));
+    pageErrors = (int *)greallocn(pageErrors, pendingPagesSize,
+				  sizeof(int));
+  }
+  pendingPages[nPendingPages] = page;
+  pageAttempts[nPendingPages] = 0;
+  pageErrors[nPendingPages] = cc->getErrors();
+  ++nPendingPages;
+}
+
+void AsyncPDFDoc::work() {
+  GBool pageFailed;
+  int page, i;
+
+  cc->work();
+  if (!cc->isOpen() || failed) {
+    return;
+  }
+
+  // an attempt that ran into missing data is repeated once everything
+  // it asked for has arrived
+  if (!doc) {
+    if (openAttempts > 0 && !cc->isIdle()) {
+      return;
+    }
+    if (!tryOpen()) {
+      cc->work();
+      if (failed) {
+	for (i = 0; i < nPendingPages; ++i) {
+	  (*cbk)(this, asyncDocFailed, pendingPages[i], cbkData);
+	}
+	nPendingPages = 0;
+      }
+      return;
+    }
+  }
+
+  for (i = 0; i < nPendingPages; ) {
+    if (pageAttempts[i] > 0 && !cc->isIdle()) {
+      ++i;
+      continue;
+    }
+    page = pendingPages[i];
+    if (tryLoadPage(i, &pageFailed)) {
+      removePage(i);
+      (*cbk)(this, asyncDocPageLoaded, page, cbkData);
+    } else if (pageFailed) {
+      removePage(i);
+      (*cbk)(this, asyncDocFailed, page, cbkData);
+    } else {
+      ++i;
+    }
+  }
+
+  // start the requests the attempts made
+  cc->work();
+}
+
+void AsyncPDFDoc::getFdSet(fd_set *readFds, fd_set *writeFds, fd_set *excFds,
+			   int *maxFd) {
+  cc->getFdSet(readFds, writeFds, excFds, maxFd);
+}
+
+long AsyncPDFDoc::getTimeout() {
+  return cc->getTimeout();
+}
+
+GBool AsyncPDFDoc::tryOpen() {
+  PDFDoc *d;
+  Object obj;
+  BaseStream *str;
+  GBool complete;
+
+  ++openAttempts;
+  beginAttempt();
+  obj.initNull();
+  str = new HttpStream(cc, 0, gFalse, 0, &obj);
+  d = new PDFDoc(str);
+  complete = endAttempt();
+
+  if (!complete) {
+    delete d;
+    if (openAttempts >= asyncDocMaxAttempts || cc->getErrors() > openErrors) {
+      errCode = errOpenFile;
+      failed = gTrue;
+      (*cbk)(this, asyncDocFailed, 0, cbkData);
+    }
+    openErrors = cc->getErrors();
+    return gFalse;
+  }
+  if (!d->isOk()) {
+    errCode = d->getErrorCode();
+    delete d;
+    failed = gTrue;
+    (*cbk)(this, asyncDocFailed, 0, cbkData);
+    return gFalse;
+  }
+  doc = d;
+  (*cbk)(this, asyncDocOpened, 0, cbkData);
+  return gTrue;
+}
+
+// A page is loaded when an attempt to read it and walk its resources
+// did not miss anything and left nothing in flight, i.e. the last batch
+// of resources it requested has arrived as well.
+GBool AsyncPDFDoc::tryLoadPage(int idx, GBool *pageFailed) {
+  Catalog *catalog;
+  Page *page;
+  GBool wasRead, complete;
+  int pageNum;
+
+  *pageFailed = gFalse;
+  catalog = doc->getCatalog();
+  pageNum = pendingPages[idx];
+  if (pageNum < 1 || pageNum > catalog->getNumPages()) {
+    *pageFailed = gTrue;
+    return gFalse;
+  }
+
+  ++pageAttempts[idx];
+  wasRead = catalog->isPageRead(pageNum);
+  beginAttempt();
+  if ((page = catalog->getPage(pageNum))) {
+    page->prefetchResources();
+  }
+  complete = endAttempt();
+
+  if (!complete) {
+    if (!wasRead) {
+      catalog->forgetPage(pageNum);
+    }
+    if (pageAttempts[idx] >= asyncDocMaxAttempts ||
+	cc->getErrors() > pageErrors[idx]) {
+      *pageFailed = gTrue;
+    }
+    pageErrors[idx] = cc->getErrors();
+    return gFalse;
+  }
+  if (!page) {
+    *pageFailed = gTrue;
+    return gFalse;
+  }
+  return cc->isIdle();
+}
+
+// Attempts run with the cache in non-blocking mode.  Their error
+// messages are mostly about truncated data, so they are not shown --
+// only on this thread, other documents still report their errors.
+void AsyncPDFDoc::beginAttempt() {
+  cc->setBlocking(gFalse);
+  attemptMisses = cc->getMisses();
+  savedErrQuiet = getThreadErrQuiet();
+  setThreadErrQuiet(gTrue);
+}
+
+// Returns true if the attempt found all the data it needed.
+GBool AsyncPDFDoc::endAttempt() {
+  setThreadErrQuiet(savedErrQuiet);
+  cc->setBlocking(gTrue);
+  return cc->getMisses() == attemptMisses;
+}
+
+void AsyncPDFDoc::removePage(int idx) {
+  int i;
+
+  for (i = idx; i + 1 < nPendingPages; ++i) {
+    pendingPages[i] = pendingPages[i+1];
+    pageAttempts[i] = pageAttempts[i+1];
+    pageErrors[i] = pageErrors[i+1];
+  }
+  --nPendingPages;
+}
+
+void AsyncPDFDoc::dataAvailable(void *data) {
+  AsyncPDFDoc *asyncDoc = (AsyncPDFDoc *)data;
+
+  (*asyncDoc->cbk)(asyncDoc, asyncDocDataAvailable, 0, asyncDoc->cbkData);
+}
+
+#endif
@@ -0,0 +1,124 @@
+//========================================================================
+//
+// AsyncPDFDoc.h
+//
+// Opening remote documents and loading their pages without blocking.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef ASYNCPDFDOC_H
+#define ASYNCPDFDOC_H
+
+#include <config.h>
+
+#ifdef ENABLE_LIBCURL
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <sys/select.h>
+#include "goo/gtypes.h"
+#include "PDFDoc.h"
+
+class GooString;
+class CurlCache;
+class AsyncPDFDoc;
+
+//------------------------------------------------------------------------
+
+// Give up on an operation after this many attempts.
+#define asyncDocMaxAttempts 64
+
+enum AsyncPDFDocEvent {
+  asyncDocOpened,		// getDoc() can be used
+  asyncDocPageLoaded,		// a page requested with loadPage is loaded
+  asyncDocDataAvailable,	// new data arrived
+  asyncDocFailed		// opening the document or loading a page
+				//   failed
+};
+
+// <page> is the page number for page events, 0 otherwise.
+typedef void (*AsyncPDFDocCbk)(AsyncPDFDoc *doc, AsyncPDFDocEvent event,
+			       int page, void *data);
+
+//------------------------------------------------------------------------
+// AsyncPDFDoc
+//
+// Drives a remote document from an event loop.  The parser reads data
+// synchronously, so every operation is attempted with the cache in
+// non-blocking mode: an attempt that runs into missing data is thrown
+// away and repeated once the data it asked for has arrived.  Each
+// attempt gets one level of references further, so an operation takes
+// about as many round trips as its blocking counterpart, but the thread
+// is free in between.
+//
+// All calls have to come from the thread running the event loop.
+//------------------------------------------------------------------------
+
+class AsyncPDFDoc {
+public:
+
+  // Start opening <urlA> and return right away.  Takes <urlA>.  <cbkA>
+  // is called from work().
+  AsyncPDFDoc(GooString *urlA, AsyncPDFDocCbk cbkA, void *cbkDataA);
+  ~AsyncPDFDoc();
+
+  // The document, NULL until asyncDocOpened was reported.  Once a page
+  // was reported as loaded it can be displayed without waiting for
+  // the network.
+  PDFDoc *getDoc() { return doc; }
+
+  // Error code after asyncDocFailed for the document.
+  int getErrorCode() { return errCode; }
+
+  // Load page <page> (1-based) with everything it refers to.  Reports
+  // asyncDocPageLoaded or asyncDocFailed.  May be called before the
+  // document is open.
+  void loadPage(int page);
+
+  // Move the transfers along without blocking, and report what got
+  // done.
+  void work();
+
+  // What to wait for before calling work() again, see
+  // CurlCache::getFdSet.
+  void getFdSet(fd_set *readFds, fd_set *writeFds, fd_set *excFds,
+		int *maxFd);
+  long getTimeout();
+
+private:
+
+  GBool tryOpen();
+  GBool tryLoadPage(int idx, GBool *pageFailed);
+  void beginAttempt();
+  GBool endAttempt();
+  void removePage(int idx);
+
+  static void dataAvailable(void *data);
+
+  GooString *url;
+  CurlCache *cc;
+  PDFDoc *doc;
+  AsyncPDFDocCbk cbk;
+  void *cbkData;
+  GBool failed;			// opening the document failed
+  int errCode;
+  int openAttempts;
+  int openErrors;		// CurlCache errors at the last attempt
+
+  int *pendingPages;		// pages requested with loadPage
+  int *pageAttempts;
+  int *pageErrors;
+  int nPendingPages;
+  int pendingPagesSize;
+
+  int attemptMisses;		// CurlCache misses at the attempt's start
+  GBool savedErrQuiet;		// thread error quiet flag before the attempt
+};
+
+#endif
+
+#endif
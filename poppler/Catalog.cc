@@ -47,6 +47,7 @@
 #include "Link.h"
 #include "PageLabelInfo.h"
 #include "Catalog.h"
+#include "Hints.h"
 #include "Form.h"
 #include "OptionalContent.h"
 
@@ -54,16 +55,18 @@
 // Catalog
 //------------------------------------------------------------------------
 
-Catalog::Catalog(XRef *xrefA) {
+Catalog::Catalog(XRef *xrefA, Hints *hintsA) {
   Object catDict, pagesDict;
   Object obj, obj2;
   Object optContentProps;
 
   ok = gTrue;
   xref = xrefA;
+  hints = hintsA;
   pages = NULL;
   pageRefs = NULL;
   numPages = pagesSize = 0;
+  pagesRead = gFalse;
   baseURI = NULL;
   pageLabelInfo = NULL;
   form = NULL;
@@ -220,34 +223,58 @@ GooString *Catalog::readMetadata() {
 }
 
 Page *Catalog::getPage(int i) {
-  if (pages) return pages[i-1];
-  else getPageFromTree(i);
+  Page *page;
+  GBool preloaded;
+
+  if (i < 1) return NULL;
+  if (i <= pagesSize && pages[i-1]) return pages[i-1];
+  if (pagesRead) return NULL;
+
+  // request everything the page needs at once, instead of fetching its
+  // objects one by one while it is parsed
+  preloaded = hints && hints->preloadPage(i);
+  page = getPageFromTree(i);
+  // hints is reset if they turned out not to match the page tree
+  if (page && preloaded && hints) {
+    page->setPrefetched();
+  }
+  return page;
+}
+
+void Catalog::forgetPage(int i) {
+  if (pagesRead || !isPageRead(i)) {
+    return;
+  }
+  delete pages[i-1];
+  pages[i-1] = NULL;
+  pageRefs[i-1].num = -1;
+  pageRefs[i-1].gen = -1;
 }
 
 Ref *Catalog::getPageRef(int i) {
-  if (pages) &pageRefs[i-1];
-  else getPageFromTree(i)->getRef();
+  Page *page;
+
+  if (pagesRead) return &pageRefs[i-1];
+  page = getPage(i);
+  return page ? page->getRef() : (Ref *)NULL;
 }
 
 void Catalog::initPages() {
   Object catDict, pagesDict, pagesDictRef;
   Object obj;
-  int numPages0, i;
+  int numPages0;
   char *alreadyRead;
 
+  if (pagesRead) {
+    return;
+  }
+  pagesRead = gTrue;
+
   // If catDict was bad, our constructor would've failed, no need to check again
   xref->getCatalog(&catDict);
 
   catDict.dictLookup("Pages", &pagesDict);
-  pagesSize = numPages;
-  
-  pages = (Page **)gmallocn(pagesSize, sizeof(Page *));
-  pageRefs = (Ref *)gmallocn(pagesSize, sizeof(Ref));
-  for (i = 0; i < pagesSize; ++i) {
-    pages[i] = NULL;
-    pageRefs[i].num = -1;
-    pageRefs[i].gen = -1;
-  }
+  growPages(numPages);
   alreadyRead = (char *)gmalloc(xref->getNumObjects());
   memset(alreadyRead, 0, xref->getNumObjects());
   if (catDict.dictLookupNF("Pages", &pagesDictRef)->isRef() &&
@@ -272,7 +299,7 @@ int Catalog::readPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
   Object kidRef;
   PageAttrs *attrs1, *attrs2;
   Page *page;
-  int i, j;
+  int i;
 
   attrs1 = new PageAttrs(attrs, pagesDict);
   pagesDict->lookup("Kids", &kids);
@@ -302,16 +329,14 @@ int Catalog::readPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
 	goto err3;
       }
       if (start >= pagesSize) {
-	pagesSize += 32;
-	pages = (Page **)greallocn(pages, pagesSize, sizeof(Page *));
-	pageRefs = (Ref *)greallocn(pageRefs, pagesSize, sizeof(Ref));
-	for (j = pagesSize - 32; j < pagesSize; ++j) {
-	  pages[j] = NULL;
-	  pageRefs[j].num = -1;
-	  pageRefs[j].gen = -1;
-	}
+	growPages(pagesSize + 32);
+      }
+      // keep the pages that were handed out by getPage
+      if (pages[start]) {
+	delete page;
+      } else {
+	pages[start] = page;
       }
-      pages[start] = page;
       if (kidRef.isRef()) {
 	pageRefs[start].num = kidRef.getRefNum();
 	pageRefs[start].gen = kidRef.getRefGen();
@@ -347,8 +372,6 @@ int Catalog::readPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
 
 Page *Catalog::getPageFromTree(int pageNo) {
   Object catDict, pagesDict, pagesDictRef;
-  Object obj;
-  int numPages0, i;
   char *alreadyRead;
   Page *page;
 
@@ -356,7 +379,6 @@ Page *Catalog::getPageFromTree(int pageNo) {
   xref->getCatalog(&catDict);
 
   catDict.dictLookup("Pages", &pagesDict);
-  pagesSize = numPages;
   
   alreadyRead = (char *)gmalloc(xref->getNumObjects());
   memset(alreadyRead, 0, xref->getNumObjects());
@@ -365,14 +387,54 @@ Page *Catalog::getPageFromTree(int pageNo) {
       pagesDictRef.getRefNum() < xref->getNumObjects()) {
     alreadyRead[pagesDictRef.getRefNum()] = 1;
   }
-  pagesDictRef.free();
   page = searchPageTree(pagesDict.getDict(), NULL, 0, pageNo, alreadyRead);
+
+  // pages that were skipped on the word of the hint tables are not
+  // checked, so make sure the right page was found
+  if (hints && page && page->getRef()->num != hints->getPageObjectNum(pageNo)) {
+    error(-1, "Linearization hints don't match the page tree");
+    delete page;
+    hints = NULL;
+    memset(alreadyRead, 0, xref->getNumObjects());
+    if (pagesDictRef.isRef() &&
+	pagesDictRef.getRefNum() >= 0 &&
+	pagesDictRef.getRefNum() < xref->getNumObjects()) {
+      alreadyRead[pagesDictRef.getRefNum()] = 1;
+    }
+    page = searchPageTree(pagesDict.getDict(), NULL, 0, pageNo, alreadyRead);
+  }
+  pagesDictRef.free();
   gfree(alreadyRead);
   pagesDict.free();
   catDict.free();
+
+  // the page is kept for later calls
+  if (page) {
+    if (pageNo > pagesSize) {
+      growPages(pageNo);
+    }
+    pages[pageNo-1] = page;
+    pageRefs[pageNo-1] = *page->getRef();
+  }
   return page;
 }
 
+void Catalog::growPages(int newSize) {
+  int i;
+
+  if (newSize <= pagesSize) {
+    return;
+  }
+  pages = (Page **)greallocn(pages, newSize, sizeof(Page *));
+  pageRefs = (Ref *)greallocn(pageRefs, newSize, sizeof(Ref));
+  for (i = pagesSize; i < newSize; ++i) {
+    pages[i] = NULL;
+    pageRefs[i].num = -1;
+    pageRefs[i].gen = -1;
+  }
+  pagesSize = newSize;
+}
+
 Page *Catalog::searchPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
 			  int needle, char *alreadyRead) {
   Object kids;
@@ -381,8 +443,9 @@ Page *Catalog::searchPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
   Object obj;
   PageAttrs *attrs1, *attrs2;
   Page *page;
-  int i, j;
+  int misses, i, j;
 
+  misses = xref->getBaseStream()->getMisses();
   attrs1 = new PageAttrs(attrs, pagesDict);
   pagesDict->lookup("Kids", &kids);
   if (!kids.isArray()) {
@@ -402,7 +465,22 @@ Page *Catalog::searchPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
       }
       alreadyRead[kidRef.getRefNum()] = 1;
     }
+    // the hint tables know which kids are single pages, those in front
+    // of the one looked for need not be fetched
+    if (hints && kidRef.isRef() && start + 1 < needle &&
+	kidRef.getRefNum() == hints->getPageObjectNum(start + 1)) {
+      ++start;
+      kidRef.free();
+      continue;
+    }
     kids.arrayGet(i, &kid);
+    // the kid's data hasn't arrived yet, the kids after it are no more
+    // use than this one
+    if (xref->getBaseStream()->getMisses() != misses) {
+      kid.free();
+      kidRef.free();
+      break;
+    }
     if (kid.isDict("Page")) {
       if (++start == needle) {
         attrs2 = new PageAttrs(attrs1, kid.getDict());
@@ -434,6 +512,8 @@ Page *Catalog::searchPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
     kidRef.free();
   }
   // page number not found
+  delete attrs1;
+  kids.free();
   return NULL;
 
  success:
@@ -41,6 +41,7 @@ class LinkDest;
 class PageLabelInfo;
 class Form;
 class OCGs;
+class Hints;
 
 //------------------------------------------------------------------------
 // NameTree
@@ -137,8 +138,9 @@ private:
 class Catalog {
 public:
 
-  // Constructor.
-  Catalog(XRef *xrefA);
+  // Constructor.  <hintsA> are the hint tables of a linearized file,
+  // they are used to load pages in one go.
+  Catalog(XRef *xrefA, Hints *hintsA = NULL);
 
   // Destructor.
   ~Catalog();
@@ -152,6 +154,15 @@ public:
   // Get a page.
   Page *getPage(int i);
 
+  // Has page <i> been read already?
+  GBool isPageRead(int i)
+    { return i >= 1 && i <= pagesSize && pages[i-1]; }
+
+  // Drop page <i> if it was read from incomplete data, so that the next
+  // getPage call reads it again.  Only for pages that were not handed
+  // out.
+  void forgetPage(int i);
+
   // Get the reference for a page object.
   Ref *getPageRef(int i);
 
@@ -226,8 +237,11 @@ public:
 private:
 
   XRef *xref;			// the xref table for this PDF file
-  Page **pages;			// array of pages
+  Hints *hints;			// linearization hints, NULL if none
+  Page **pages;			// array of pages, NULL entries have not
+				//   been read yet
   Ref *pageRefs;		// object ID for each page
+  GBool pagesRead;		// the whole page tree has been read
   Form *form;
   int numPages;			// number of pages
   int pagesSize;		// size of pages array
@@ -250,6 +264,7 @@ private:
   int readPageTree(Dict *pages, PageAttrs *attrs, int start,
 		   char *alreadyRead);
   Page *getPageFromTree(int pageNo);
+  void growPages(int newSize);
   Page *searchPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
 		   int needle, char *alreadyRead);
   Object *findDestInTree(Object *tree, GooString *name, Object *obj);
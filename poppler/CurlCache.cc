@@ -18,34 +18,462 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+#include "goo/gmem.h"
 #include "Error.h"
+#include "GlobalParams.h"
+#include "CurlDiskCache.h"
 #include <curl/curl.h>
 
 //------------------------------------------------------------------------
 
-CurlCache::CurlCache(GooString *urlA) {
+#if MULTITHREADED
+#  define lockCache     gLockMutex(&mutex)
+#  define unlockCache   gUnlockMutex(&mutex)
+#  define signalCache   gCondBroadcast(&chunkCond)
+#else
+#  define lockCache
+#  define unlockCache
+#  define signalCache
+#endif
+
+// Weight of a new sample in the running timing averages.
+#define timingSampleWeight 0.25
+
+// Transfers smaller than this say nothing about throughput.
+#define minThroughputSample (16 * 1024)
+
+// Current time in seconds.
+static double getTime() {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Returns the "scheme://host:port" part of <url>.
+static GooString *getHost(GooString *url) {
+  int i = 0;
+
+  while (i < url->getLength() && url->getChar(i) != ':') ++i;
+  i += 3;
+  if (i > url->getLength()) {
+    return url->copy();
+  }
+  while (i < url->getLength() && url->getChar(i) != '/') ++i;
+  return new GooString(url, 0, i);
+}
+
+// Parse "bytes <first>-<last>/<length>" from a Content-Range header.
+static GBool parseContentRange(const char *p, size_t *first, size_t *last) {
+  unsigned long a, b;
+
+  while (*p == ' ') ++p;
+  if (strncasecmp(p, "bytes", 5)) {
+    return gFalse;
+  }
+  if (sscanf(p + 5, " %lu-%lu", &a, &b) != 2 || b < a) {
+    return gFalse;
+  }
+  *first = a;
+  *last = b;
+  return gTrue;
+}
+
+// Get <length> from "bytes <first>-<last>/<length>" or "bytes */<length>".
+static long parseContentRangeLength(const char *p) {
+  unsigned long n;
+
+  if (!(p = strchr(p, '/')) || sscanf(p + 1, "%lu", &n) != 1) {
+    return -1;
+  }
+  return (long)n;
+}
+
+//------------------------------------------------------------------------
+// CurlChunkTable
+//------------------------------------------------------------------------
+
+CurlChunkTable::CurlChunkTable(int nChunksA, int chunkSizeA) {
+  int i;
+
+  nChunks = nChunksA;
+  chunkSize = chunkSizeA;
+  chunks = (CurlCacheChunk *)gmallocn(nChunks, sizeof(CurlCacheChunk));
+  for (i = 0; i < nChunks; ++i) {
+    chunks[i].state = cccStateNew;
+    chunks[i].pins = 0;
+    chunks[i].referenced = gFalse;
+    chunks[i].used = gFalse;
+    chunks[i].slot = -1;
+    chunks[i].job = NULL;
+  }
+  slabs = NULL;
+  nSlabs = 0;
+  freeSlots = NULL;
+  nFree = 0;
+  nUsed = 0;
+}
+
+CurlChunkTable::~CurlChunkTable() {
+  int i;
+
+  for (i = 0; i < nSlabs; ++i) {
+    gfree(slabs[i]);
+  }
+  gfree(slabs);
+  gfree(freeSlots);
+  gfree(chunks);
+}
+
+void CurlChunkTable::allocSlot(int i) {
+  int j;
+
+  if (nFree == 0) {
+    // all slots are taken, add another slab
+    slabs = (char **)greallocn(slabs, nSlabs + 1, sizeof(char *));
+    slabs[nSlabs] = (char *)gmallocn(curlChunkSlabSize, chunkSize);
+    freeSlots = (int *)greallocn(freeSlots, (nSlabs + 1) * curlChunkSlabSize,
+				 sizeof(int));
+    // hand out the slots of the new slab in ascending order
+    for (j = curlChunkSlabSize - 1; j >= 0; --j) {
+      freeSlots[nFree++] = nSlabs * curlChunkSlabSize + j;
+    }
+    ++nSlabs;
+  }
+  chunks[i].slot = freeSlots[--nFree];
+  ++nUsed;
+}
+
+void CurlChunkTable::freeData(int i) {
+  if (chunks[i].slot >= 0) {
+    freeSlots[nFree++] = chunks[i].slot;
+    chunks[i].slot = -1;
+    --nUsed;
+  }
+}
+
+//------------------------------------------------------------------------
+// CurlCache
+//------------------------------------------------------------------------
+
+CurlCache::CurlCache(GooString *urlA, GBool wait) {
+  HttpHostTiming timing;
+
   url = urlA;
 
-  long code = NULL;
-  double contentLength = -1;
-
-  curl = curl_easy_init();
-  curl_easy_setopt(curl, CURLOPT_URL, url->getCString());
-  curl_easy_setopt(curl, CURLOPT_HEADER, 1);
-  curl_easy_setopt(curl, CURLOPT_NOBODY, 1);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &CurlCache::noop);
-  curl_easy_perform(curl);
-  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
-  curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &contentLength);
-  curl_easy_reset(curl);
-  
-  size = contentLength;
-  
-  streamPos = 0;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+  gInitCond(&chunkCond);
+#endif
+  driving = gFalse;
+
+  // timing of earlier documents from the same host is a better guess
+  // than the defaults
+  host = getHost(url);
+  if (globalParams->getHttpHostTiming(host, &timing)) {
+    rtt = timing.rtt;
+    throughput = timing.throughput;
+  } else {
+    rtt = curlCacheDefaultRtt;
+    throughput = curlCacheDefaultThroughput;
+  }
+
+  chunkSize = globalParams->getHttpChunkSize();
+  if (chunkSize < curlCacheMinChunkSize) {
+    chunkSize = curlCacheMinChunkSize;
+  }
+  adaptive = globalParams->getHttpAdaptiveChunks();
+
+  // reuse chunks stored by earlier sessions if the document did not
+  // change in between
+  GooString *cacheDir = globalParams->getHttpCacheDir();
+  diskCache = NULL;
+  if (cacheDir) {
+    diskCache = new CurlDiskCache(cacheDir, url, chunkSize);
+    if (!diskCache->isOk()) {
+      delete diskCache;
+      diskCache = NULL;
+    }
+    delete cacheDir;
+  }
+
+  etag = lastModified = NULL;
+  size = 0;
+  chunks = NULL;
+  clockHand = 0;
+  streaming = gFalse;
+  streamJob = NULL;
+  blocking = gTrue;
+  misses = errors = loadCount = 0;
+  dataCbk = NULL;
+  dataCbkData = NULL;
+  stats.clear();
+
+  multi = curl_multi_init();
+  maxConnections = 0;
+  setMaxConnections(globalParams->getHttpMaxConnections());
+  maxMemory = globalParams->getHttpMemoryCacheSize();
+  multiRange = globalParams->getHttpMultiRange();
+
+  startOpen();
+  if (wait) {
+    double t0 = getTime();
+    while (opening) {
+      performOpen();
+      if (opening) {
+#if LIBCURL_VERSION_NUM >= 0x074200
+	curl_multi_poll(multi, NULL, 0, curlCacheWaitTimeout, NULL);
+#else
+	curl_multi_wait(multi, NULL, 0, curlCacheWaitTimeout, NULL);
+#endif
+      }
+    }
+    stats.waitTime += getTime() - t0;
+  }
+}
+
+// The first chunks (for the header and the linearization dictionary)
+// and the tail (for the trailer) are requested at the same time; the
+// size of the document comes with the Content-Range of either.
+void CurlCache::startOpen() {
+  size_t headSize, tailSize;
+  int i;
+
+  headSize = curlCacheHeadChunks * chunkSize;
+  tailSize = curlCacheTailChunks * chunkSize;
+  if (adaptive && getMinRequestSize() > tailSize) {
+    headSize = tailSize = getMinRequestSize();
+  }
+
+  openConditions = NULL;
+  if (diskCache && diskCache->getSize() >= 0) {
+    // a 304 confirms the stored copy, which then also serves the head
+    GooString *cond = NULL;
+    if (diskCache->getETag()) {
+      cond = GooString::format("If-None-Match: {0:t}", diskCache->getETag());
+    } else if (diskCache->getLastModified()) {
+      cond = GooString::format("If-Modified-Since: {0:t}",
+			       diskCache->getLastModified());
+    }
+    if (cond) {
+      openConditions = curl_slist_append(openConditions, cond->getCString());
+      delete cond;
+    }
+  }
+
+  opening = gTrue;
+  if (openConditions) {
+    // only the tail request is sent, with the condition
+    setupOpen(&openReqs[0], NULL, 0);
+  } else {
+    setupOpen(&openReqs[0],
+	      GooString::format("0-{0:uld}", (unsigned long)headSize - 1), headSize);
+  }
+  setupOpen(&openReqs[1], GooString::format("-{0:uld}", (unsigned long)tailSize),
+	    tailSize);
+  for (i = 0; i < 2; ++i) {
+    if (openReqs[i].curl) {
+      curl_multi_add_handle(multi, openReqs[i].curl);
+    }
+  }
+}
+
+// Move the opening requests along, and set the cache up once both are
+// done.
+void CurlCache::performOpen() {
+  CURLMsg *msg;
+  int running, n, i;
+
+  curl_multi_perform(multi, &running);
+  while ((msg = curl_multi_info_read(multi, &n))) {
+    if (msg->msg == CURLMSG_DONE) {
+      for (i = 0; i < 2; ++i) {
+	if (msg->easy_handle == openReqs[i].curl && !openReqs[i].done) {
+	  finishOpen(&openReqs[i], msg->data.result);
+	}
+      }
+    }
+  }
+  if (openReqs[0].done && openReqs[1].done) {
+    openDone();
+  }
+}
+
+void CurlCache::openDone() {
+  CurlCacheOpen *head, *tail, *cco;
+  int i;
+
+  head = &openReqs[0];
+  tail = &openReqs[1];
+  curl_slist_free_all(openConditions);
+  openConditions = NULL;
+
+  // the tail answer decides unless it failed
+  cco = (tail->status == 200 || tail->status == 206 || tail->status == 304 ||
+	 tail->status == 416 || head->status == 0) ? tail : head;
+  etag = cco->etag;
+  lastModified = cco->lastModified;
+  cco->etag = cco->lastModified = NULL;
+
+  if (diskCache && cco->status == 304) {
+    size = diskCache->getSize();
+    if (!etag && diskCache->getETag()) {
+      etag = diskCache->getETag()->copy();
+    }
+    if (!lastModified && diskCache->getLastModified()) {
+      lastModified = diskCache->getLastModified()->copy();
+    }
+  } else {
+    size = (cco->status == 200 || cco->status == 206 || cco->status == 416)
+             ? cco->total : -1;
+    // documents without validators can't be checked next time
+    if (diskCache && (size < 0 ||
+		      !diskCache->validate(size, etag, lastModified))) {
+      delete diskCache;
+      diskCache = NULL;
+    }
+  }
+
+  if (size < 0) {
+    error(-1, "Couldn't get the size of '%s'", url->getCString());
+    size = 0;
+    ++errors;
+  }
+  chunks = new CurlChunkTable((size + chunkSize - 1) / chunkSize,
+			      chunkSize);
+
+  // both answers describe the same document if they agree on its size
+  if (tail->status == 206 || tail->status == 200) {
+    seedChunks(tail->first, tail->data);
+  }
+  if ((head->status == 206 || head->status == 200) && head->total == size) {
+    seedChunks(head->first, head->data);
+  }
+
+  // a server that ignores ranges sends the whole document every time,
+  // and a small document costs hardly more than a range of it: get all
+  // of it with one request
+  if (head->status == 200 || tail->status == 200 ||
+      (size > 0 && size <= curlCacheStreamSize)) {
+    lockCache;
+    startStreaming();
+    scheduleChunks(0, chunks->getNumChunks() - 1);
+    unlockCache;
+  }
+
+  // the opening handles become the first connections of the pool
+  for (i = 0; i < 2; ++i) {
+    if (openReqs[i].curl) {
+      idleHandles.push_back(openReqs[i].curl);
+    }
+    delete openReqs[i].data;
+    delete openReqs[i].etag;
+    delete openReqs[i].lastModified;
+  }
+  opening = gFalse;
+}
+
+// Prepare one of the requests that open the document.  Takes <range>.
+// A NULL <range> leaves the request out: it counts as done, without
+// an answer.
+void CurlCache::setupOpen(CurlCacheOpen *cco, GooString *range,
+			  size_t maxData) {
+  CURL *curlA;
+
+  cco->cc = this;
+  cco->status = 0;
+  cco->total = -1;
+  cco->first = 0;
+  cco->maxData = maxData;
+  cco->range = range;
+  cco->etag = cco->lastModified = NULL;
+  if (!range) {
+    cco->curl = NULL;
+    cco->done = gTrue;
+    cco->data = NULL;
+    return;
+  }
+  curlA = curl_easy_init();
+  cco->curl = curlA;
+  cco->done = gFalse;
+  cco->data = new GooString();
+  ++stats.requests;
+  stats.bytesRequested += maxData;
+
+  curl_easy_setopt(curlA, CURLOPT_URL, url->getCString());
+  curl_easy_setopt(curlA, CURLOPT_RANGE, range->getCString());
+  curl_easy_setopt(curlA, CURLOPT_WRITEFUNCTION, &CurlCache::openWrite);
+  curl_easy_setopt(curlA, CURLOPT_WRITEDATA, cco);
+  curl_easy_setopt(curlA, CURLOPT_HEADERFUNCTION, &CurlCache::openHeader);
+  curl_easy_setopt(curlA, CURLOPT_HEADERDATA, cco);
+  if (openConditions) {
+    curl_easy_setopt(curlA, CURLOPT_HTTPHEADER, openConditions);
+  }
+}
+
+// Called when one of the requests that open the document is done.
+void CurlCache::finishOpen(CurlCacheOpen *cco, CURLcode result) {
+  if (result == CURLE_OK && cco->status == 200 && cco->total < 0) {
+    // a complete body without Content-Length
+    cco->total = cco->data->getLength();
+  }
+  addTimingSample(cco->curl);
+  countRequest(cco->curl);
+  curl_multi_remove_handle(multi, cco->curl);
+  curl_easy_reset(cco->curl);
+  delete cco->range;
+  cco->range = NULL;
+  cco->done = gTrue;
 }
 
 CurlCache::~CurlCache() {
-  curl_easy_cleanup(curl);
+  std::list<CurlCacheJob *>::iterator it;
+  std::vector<CURL *>::iterator h;
+
+  // abort everything that is still queued or in flight
+  if (opening) {
+    for (int i = 0; i < 2; ++i) {
+      if (openReqs[i].curl) {
+	curl_multi_remove_handle(multi, openReqs[i].curl);
+	curl_easy_cleanup(openReqs[i].curl);
+      }
+      delete openReqs[i].range;
+      delete openReqs[i].data;
+      delete openReqs[i].etag;
+      delete openReqs[i].lastModified;
+    }
+    curl_slist_free_all(openConditions);
+  }
+  for (it = activeJobs.begin(); it != activeJobs.end(); ++it) {
+    curl_multi_remove_handle(multi, (*it)->getHandle());
+    curl_easy_cleanup((*it)->getHandle());
+    delete *it;
+  }
+  for (it = pendingJobs.begin(); it != pendingJobs.end(); ++it) {
+    delete *it;
+  }
+  for (h = idleHandles.begin(); h != idleHandles.end(); ++h) {
+    curl_easy_cleanup(*h);
+  }
+  curl_multi_cleanup(multi);
+  if (diskCache) {
+    diskCache->flush();
+    // only an entry that grew can push the cache over its size
+    if (diskCache->hasGrown()) {
+      diskCache->trim(globalParams->getHttpCacheSize());
+    }
+    delete diskCache;
+  }
+  delete chunks;
+  delete host;
+  delete etag;
+  delete lastModified;
+#if MULTITHREADED
+  gDestroyCond(&chunkCond);
+  gDestroyMutex(&mutex);
+#endif
 }
 
 GooString *CurlCache::getFileName() {
@@ -53,7 +481,7 @@ GooString *CurlCache::getFileName() {
   for (i = 6; i < url->getLength(); i++) {
     // note position after last slash
     if (url->getChar(i) == '/') sl = i+1;
-	
+
     // note position of first question mark
     if (url->getChar(i) == '?' && !qm) qm = i;
   }
@@ -61,167 +489,1085 @@ GooString *CurlCache::getFileName() {
   return new GooString(url, sl, (qm) ? qm : (url->getLength()-sl));
 }
 
-long int CurlCache::tell() {
-  return streamPos;
+void CurlCache::setMaxConnections(int maxConnectionsA) {
+  if (maxConnectionsA < 1) {
+    maxConnectionsA = 1;
+  }
+  lockCache;
+  maxConnections = maxConnectionsA;
+  unlockCache;
+  curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)maxConnectionsA);
+  curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long)maxConnectionsA);
 }
 
-int CurlCache::seek(long int offset, int origin) {
-  if (origin == SEEK_SET) {
-    streamPos = offset;
-  } else if (origin == SEEK_CUR) {
-    streamPos += offset;
-  } else {
-    streamPos = size + offset;
-  }
-  
-  if (streamPos > size) {
-    streamPos = 0;
-    return 1;
-  }
-  
-  return 0;
+void CurlCache::setMaxMemory(size_t maxMemoryA) {
+  lockCache;
+  maxMemory = maxMemoryA;
+  evictChunks();
+  unlockCache;
 }
 
-size_t CurlCache::read(void *ptr, size_t unitsize, size_t count) {
-  size_t bytes = unitsize*count;
-  size_t endPos = streamPos + bytes;
-  //printf("Reading %li - %li\n", streamPos, streamPos + unitsize*count);
-  
-  if (endPos > size) {
+void CurlCache::pin(size_t start, size_t end) {
+  if (end > (size_t)size) end = size;
+  if (start >= end) return;
+
+  lockCache;
+  pinChunks(start / chunkSize, (end - 1) / chunkSize, 1);
+  unlockCache;
+}
+
+void CurlCache::unpin(size_t start, size_t end) {
+  if (end > (size_t)size) end = size;
+  if (start >= end) return;
+
+  lockCache;
+  pinChunks(start / chunkSize, (end - 1) / chunkSize, -1);
+  evictChunks();
+  unlockCache;
+}
+
+size_t CurlCache::readAt(size_t offset, void *buf, size_t len) {
+  size_t endPos = offset + len;
+  char *p = (char *)buf;
+
+  if (offset >= (size_t)size) {
+    return 0;
+  }
+  if (endPos > (size_t)size) {
     endPos = size;
-    bytes = size - streamPos;
+    len = size - offset;
+  }
+  if (len == 0) {
+    return 0;
   }
-  
-  if (bytes == 0) return 0;
-  
-  preload(streamPos, endPos);
-  
+
+  int startBlock = offset / chunkSize;
+  int endBlock = (endPos - 1) / chunkSize;
+
+  lockCache;
+
+  for (int i = startBlock; i <= endBlock; ++i) {
+    if (chunks->get(i)->state == cccStateLoaded) {
+      ++stats.chunkHits;
+    } else {
+      ++stats.chunkMisses;
+    }
+  }
+
+  // Make sure data is in cache, and stays there until it is copied
+  pinChunks(startBlock, endBlock, 1);
+  scheduleChunks(startBlock, endBlock);
+  if (!blocking) {
+    // hand out what is there, the rest arrives later
+    int i;
+    for (i = startBlock;
+	 i <= endBlock && chunks->get(i)->state == cccStateLoaded;
+	 ++i) ;
+    if (i <= endBlock) {
+      ++misses;
+      pinChunks(startBlock, endBlock, -1);
+      endBlock = i - 1;
+      if (endBlock < startBlock) {
+	unlockCache;
+	return 0;
+      }
+      pinChunks(startBlock, endBlock, 1);
+      len = (size_t)(endBlock + 1) * chunkSize - offset;
+    }
+  } else if (!waitForChunks(startBlock, endBlock)) {
+    pinChunks(startBlock, endBlock, -1);
+    unlockCache;
+    return 0;
+  }
+
   // Write data to buffer
-  size_t toCopy = bytes;
-  
+  size_t toCopy = len;
+
   while (toCopy) {
-    int chunk = streamPos / curlCacheChunkSize;
-    int offset = streamPos % curlCacheChunkSize;
-  
-    int len = curlCacheChunkSize-offset;
-  
-    if (len > toCopy)
-      len = toCopy;
+    int chunk = offset / chunkSize;
+    int chunkOffset = offset % chunkSize;
 
-    //printf("Reading Chunk %i, offset %i, len %i\n", chunk, offset, len);
-    memcpy(ptr, chunks[chunk].data + offset, len);
-    streamPos += len;
-    toCopy -= len;
-    ptr = (char*)ptr + len;
-    
-    /*
-    // Dump a chunk
-    if (chunk == 28 || chunk == 29) {
-      for (int i = 0; i < len; ++i) {
-        printf("%02X ", (unsigned char) chunks[chunk].data[offset + i]);
-      }
-      printf("\n");
+    size_t n = chunkSize-chunkOffset;
+
+    if (n > toCopy)
+      n = toCopy;
+
+    memcpy(p, chunks->getData(chunk) + chunkOffset, n);
+    chunks->get(chunk)->referenced = gTrue;
+    if (!chunks->get(chunk)->used) {
+      chunks->get(chunk)->used = gTrue;
+      stats.bytesUsed += chunkLength(chunk);
     }
-    */
+    offset += n;
+    toCopy -= n;
+    p += n;
   }
-  
-  return bytes;
+  pinChunks(startBlock, endBlock, -1);
+  evictChunks();
+  unlockCache;
+
+  return len;
 }
 
 void CurlCache::preload(size_t start, size_t end) {
-  if (end == 0 || end > size) end = size;
-  if (start > end) start = end - curlCacheChunkSize;
-
-  int startBlock = start / curlCacheChunkSize;
-  int startSkip = start % curlCacheChunkSize;
-  
-  int endBlock = (end-1) / curlCacheChunkSize;
-  int endSkip = curlCacheChunkSize-1 - ((end-1) % curlCacheChunkSize);
-  
-  //printf("Get block %i to %i, skipping %i at start and %i at end.\n", startBlock, endBlock, startSkip, endSkip);
-  
-  // Make sure data is in cache
-  loadChunks(startBlock, endBlock);
-}
-
-void CurlCache::loadChunks(int startBlock, int endBlock) {
-  int startSequence;
-  int i = startBlock;
-  
+  preload(1, &start, &end);
+}
+
+void CurlCache::preload(int nRanges, size_t *starts, size_t *ends) {
+  CurlCacheJob *ccj;
+  size_t start, end;
+  GBool drive;
+  int i;
+
+  // Only queue the requests, whoever reads the data will wait for them
+  lockCache;
+  ccj = NULL;
+  for (i = 0; i < nRanges; ++i) {
+    start = starts[i];
+    end = ends[i];
+    if (end == 0 || end > (size_t)size) end = size;
+    if (start > end) start = end > (size_t)chunkSize ? end - chunkSize : 0;
+    if (start >= end) continue;
+
+    ccj = scheduleChunks(start / chunkSize, (end-1) / chunkSize, ccj);
+  }
+  if ((drive = !driving)) {
+    driving = gTrue;
+  }
+  unlockCache;
+
+  // start the transfers right away unless another thread takes care
+  // of them
+  if (drive) {
+    startJobs();
+    perform();
+    lockCache;
+    driving = gFalse;
+    signalCache;
+    unlockCache;
+  }
+}
+
+GBool CurlCache::loadChunks(int startBlock, int endBlock) {
+  GBool ok;
+
+  if (startBlock < 0) startBlock = 0;
+  if (endBlock >= chunks->getNumChunks()) endBlock = chunks->getNumChunks() - 1;
+  if (startBlock > endBlock) return gTrue;
+
+  lockCache;
+  pinChunks(startBlock, endBlock, 1);
+  scheduleChunks(startBlock, endBlock);
+  ok = waitForChunks(startBlock, endBlock);
+  pinChunks(startBlock, endBlock, -1);
+  evictChunks();
+  unlockCache;
+  return ok;
+}
+
+CurlCacheJob *CurlCache::scheduleChunks(int startBlock, int endBlock,
+					CurlCacheJob *ccj) {
+  int maxGap = getMergeGap() / chunkSize;
+  int minRun = getMinRequestSize() / chunkSize;
+  int nChunks = chunks->getNumChunks();
+  int startSequence, gap;
+  int i, j;
+
+  // chunks stored on disk don't need a request
+  if (diskCache) {
+    for (i = startBlock; i <= endBlock; ++i) {
+      CurlCacheChunk *c = chunks->get(i);
+      if (c->state == cccStateNew && diskCache->hasChunk(i)) {
+	if (diskCache->readChunk(i, chunks->getData(i), chunkLength(i))) {
+	  c->state = cccStateLoaded;
+	  c->referenced = gTrue;
+	} else {
+	  chunks->freeData(i);
+	}
+      }
+    }
+  }
+
+  if (streaming) {
+    streamChunks(startBlock, endBlock);
+    return ccj;
+  }
+
+  i = startBlock;
   while (i <= endBlock) {
-    if (chunks[i].state == cccStateNew) {
+    if (chunks->get(i)->state == cccStateNew) {
       startSequence = i;
+      chunks->get(i)->state = cccStateLoading;
       while (i < endBlock) {
         i++;
-        if (chunks[i].state != cccStateNew) {
+        if (chunks->get(i)->state == cccStateNew) {
+          chunks->get(i)->state = cccStateLoading;
+        } else if ((gap = loadedGap(i, endBlock)) &&
+		   gap <= maxGap) {
+	  // loading a few chunks again is cheaper than another range
+	  stats.bytesRefetched += (size_t)gap * chunkSize;
+	  i += gap - 1;
+	} else {
           i--;
           break;
         }
       }
-      
-      CurlCacheJob *ccj = new CurlCacheJob(this, startSequence, i);
-      ccj->run();
+
+      // a short request takes about as long as one that keeps the link
+      // busy for a whole round trip, so read ahead up to that size
+      while (i + 1 < nChunks && i + 1 - startSequence < minRun &&
+	     chunks->get(i + 1)->state == cccStateNew &&
+	     !(diskCache && diskCache->hasChunk(i + 1))) {
+	++i;
+	chunks->get(i)->state = cccStateLoading;
+      }
+
+      // collect the gaps into multi-range requests if the server
+      // supports them
+      if (ccj && multiRange && ccj->getNumRanges() < curlCacheMaxRanges) {
+	ccj->addRange(startSequence, i);
+      } else {
+	ccj = new CurlCacheJob(this, startSequence, i);
+	pendingJobs.push_back(ccj);
+      }
+      for (j = startSequence; j <= i; ++j) {
+	if (chunks->get(j)->state == cccStateLoading) {
+	  chunks->get(j)->job = ccj;
+	}
+      }
     }
     i++;
   }
+
+#if MULTITHREADED && LIBCURL_VERSION_NUM >= 0x074400
+  // don't let the driving thread sleep on its old transfers
+  if (ccj && driving) {
+    curl_multi_wakeup(multi);
+  }
+#endif
+  return ccj;
 }
 
-size_t CurlCache::noop(void *ptr, size_t size, size_t nmemb, void *ptr2) {
-  return size*nmemb;
+// Switch to whole-document downloads.  Queued range requests would only
+// be answered with the whole document too: their chunks are handed to
+// the download instead.  Called with the cache locked.
+void CurlCache::startStreaming() {
+  std::list<CurlCacheJob *> jobs;
+  std::list<CurlCacheJob *>::iterator it;
+  std::vector<CurlCacheRange>::iterator r;
+  int i;
+
+  if (streaming) {
+    return;
+  }
+  streaming = gTrue;
+  jobs.swap(pendingJobs);
+  for (it = jobs.begin(); it != jobs.end(); ++it) {
+    for (r = (*it)->ranges.begin(); r != (*it)->ranges.end(); ++r) {
+      for (i = r->startBlock; i <= r->endBlock; ++i) {
+	if (chunks->get(i)->state == cccStateLoading &&
+	    chunks->get(i)->job == *it) {
+	  chunks->get(i)->state = cccStateNew;
+	}
+      }
+      streamChunks(r->startBlock, r->endBlock);
+    }
+    delete *it;
+  }
+}
+
+// Assign the missing chunks in [startBlock, endBlock] to the latest
+// whole-document download, or start a new one if that has passed them
+// already.  Called with the cache locked.
+void CurlCache::streamChunks(int startBlock, int endBlock) {
+  CurlCacheChunk *c;
+  GBool added;
+  int i;
+
+  added = gFalse;
+  for (i = startBlock; i <= endBlock; ++i) {
+    c = chunks->get(i);
+    if (c->state != cccStateNew) {
+      continue;
+    }
+    if (!streamJob || streamJob->getCurrentByte() > (size_t)i * chunkSize) {
+      streamJob = new CurlCacheJob(this, 0, chunks->getNumChunks() - 1,
+				   gTrue);
+      pendingJobs.push_back(streamJob);
+      added = gTrue;
+    }
+    c->state = cccStateLoading;
+    c->job = streamJob;
+  }
+
+#if MULTITHREADED && LIBCURL_VERSION_NUM >= 0x074400
+  if (added && driving) {
+    curl_multi_wakeup(multi);
+  }
+#endif
+}
+
+// Number of bytes of the document in <chunk>.
+int CurlCache::chunkLength(int chunk) {
+  size_t start = (size_t)chunk * chunkSize;
+
+  if (start + chunkSize > (size_t)size) {
+    return size - start;
+  }
+  return chunkSize;
+}
+
+// Called with the cache locked when <chunk> has been downloaded.
+void CurlCache::chunkLoaded(int chunk) {
+  CurlCacheChunk *c = chunks->get(chunk);
+
+  c->state = cccStateLoaded;
+  ++loadCount;
+  // give preloaded data a chance to be read before it is evicted
+  c->referenced = gTrue;
+  if (diskCache) {
+    diskCache->writeChunk(chunk, chunks->getData(chunk), chunkLength(chunk));
+  }
+  signalCache;
+  evictChunks();
+}
+
+// Called with the cache locked.
+void CurlCache::pinChunks(int startBlock, int endBlock, int delta) {
+  int i;
+
+  for (i = startBlock; i <= endBlock; ++i) {
+    chunks->get(i)->pins += delta;
+  }
+}
+
+// Drop chunks until the cache fits into maxMemory again, using the
+// CLOCK approximation of LRU: the hand sweeps over the chunks in file
+// order and evicts the first one that was not read since its last
+// visit.  Pinned chunks and chunks that are being loaded stay.  Called
+// with the cache locked.
+void CurlCache::evictChunks() {
+  CurlCacheChunk *c;
+  int maxChunks, nChunks, visits, i;
+
+  if (!maxMemory) {
+    return;
+  }
+  maxChunks = maxMemory / chunkSize;
+  if (maxChunks < curlCacheMinChunks) {
+    maxChunks = curlCacheMinChunks;
+  }
+
+  // two rounds clear every reference bit, so anything still left is
+  // pinned or loading
+  nChunks = chunks->getNumChunks();
+  visits = 2 * nChunks;
+  while (chunks->getNumBuffers() > maxChunks && visits--) {
+    if (clockHand >= nChunks) {
+      clockHand = 0;
+    }
+    i = clockHand++;
+    c = chunks->get(i);
+    if (c->slot < 0 || c->pins || c->state != cccStateLoaded) {
+      continue;
+    }
+    if (c->referenced) {
+      c->referenced = gFalse;
+      continue;
+    }
+    chunks->freeData(i);
+    c->state = cccStateNew;
+  }
+}
+
+// Returns the number of loaded chunks starting at <block> if they are
+// followed by a new chunk no later than <endBlock>, 0 otherwise.
+int CurlCache::loadedGap(int block, int endBlock) {
+  int i;
+
+  for (i = block; i <= endBlock; ++i) {
+    if (chunks->get(i)->state == cccStateNew) {
+      return i - block;
+    } else if (chunks->get(i)->state != cccStateLoaded) {
+      break;
+    }
+  }
+  return 0;
+}
+
+size_t CurlCache::getMinRequestSize() {
+  size_t n;
+
+  if (!adaptive) {
+    return chunkSize;
+  }
+  n = getMergeGap();
+  return n < (size_t)chunkSize ? chunkSize : n;
+}
+
+size_t CurlCache::getMergeGap() {
+  double gap = rtt * throughput;
+
+  if (gap > curlCacheMaxMergeGap) {
+    gap = curlCacheMaxMergeGap;
+  }
+  return (size_t)gap;
+}
+
+void CurlCache::countRequest(CURL *curl) {
+  double total = 0;
+#if LIBCURL_VERSION_NUM >= 0x073700
+  curl_off_t bytes = 0;
+#else
+  double bytes = 0;
+#endif
+
+  curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total);
+#if LIBCURL_VERSION_NUM >= 0x073700
+  curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+#else
+  curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD, &bytes);
+#endif
+  lockCache;
+  stats.bytesReceived += (size_t)bytes;
+  stats.addRequestTime(total);
+  unlockCache;
+}
+
+void CurlCache::getStats(NetStats *statsA) {
+  lockCache;
+  *statsA = stats;
+  statsA->failedRequests = errors;
+  unlockCache;
+}
+
+void CurlCache::addTimingSample(CURL *curl) {
+  HttpHostTiming timing;
+  double pretransfer = 0, starttransfer = 0, total = 0, bytes = 0;
+#if LIBCURL_VERSION_NUM >= 0x073700
+  curl_off_t size = 0;
+#endif
+
+  curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME, &pretransfer);
+  curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &starttransfer);
+  curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total);
+#if LIBCURL_VERSION_NUM >= 0x073700
+  curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &size);
+  bytes = (double)size;
+#else
+  curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD, &bytes);
+#endif
+
+  lockCache;
+  // time from sending the request to the first response byte
+  if (starttransfer > pretransfer) {
+    rtt += timingSampleWeight * ((starttransfer - pretransfer) - rtt);
+  }
+  if (bytes >= minThroughputSample && total > starttransfer) {
+    throughput += timingSampleWeight *
+                  (bytes / (total - starttransfer) - throughput);
+  }
+
+  timing.rtt = rtt;
+  timing.throughput = throughput;
+  unlockCache;
+  globalParams->setHttpHostTiming(host, &timing);
+}
+
+GBool CurlCache::waitForChunks(int startBlock, int endBlock) {
+  double t0 = 0;
+  int i = startBlock;
+
+  while (i <= endBlock) {
+    CurlCacheChunkState state = chunks->get(i)->state;
+    if (state == cccStateLoaded) {
+      ++i;
+      continue;
+    }
+    if (t0 == 0) {
+      t0 = getTime();
+    }
+    if (state == cccStateNew) {
+      // the job covering this chunk has failed
+      stats.waitTime += getTime() - t0;
+      return gFalse;
+    } else if (!driving) {
+      // nobody is running the transfers, so do it ourselves
+      driving = gTrue;
+      unlockCache;
+      drive();
+      lockCache;
+      driving = gFalse;
+      // let another waiter take over if we are done
+      signalCache;
+    } else {
+#if MULTITHREADED
+      gCondWait(&chunkCond, &mutex);
+#endif
+    }
+  }
+  if (t0 != 0) {
+    stats.waitTime += getTime() - t0;
+  }
+  return gTrue;
+}
+
+void CurlCache::work() {
+  int n;
+
+  if (opening) {
+    performOpen();
+    if (!opening && dataCbk) {
+      (*dataCbk)(dataCbkData);
+    }
+    return;
+  }
+
+  lockCache;
+  if (driving) {
+    // another thread runs the transfers
+    unlockCache;
+    return;
+  }
+  driving = gTrue;
+  n = loadCount;
+  unlockCache;
+
+  startJobs();
+  perform();
+
+  lockCache;
+  driving = gFalse;
+  n = loadCount - n;
+  signalCache;
+  unlockCache;
+  if (n > 0 && dataCbk) {
+    (*dataCbk)(dataCbkData);
+  }
+}
+
+void CurlCache::getFdSet(fd_set *readFds, fd_set *writeFds, fd_set *excFds,
+			 int *maxFd) {
+  curl_multi_fdset(multi, readFds, writeFds, excFds, maxFd);
+}
+
+long CurlCache::getTimeout() {
+  long timeout = -1;
+
+  curl_multi_timeout(multi, &timeout);
+  return timeout;
+}
+
+GBool CurlCache::isIdle() {
+  GBool idle;
+
+  if (opening) {
+    return gFalse;
+  }
+  lockCache;
+  idle = pendingJobs.empty() && activeJobs.empty();
+  unlockCache;
+  return idle;
+}
+
+void CurlCache::drive() {
+  GBool done;
+  int n;
+
+  lockCache;
+  n = loadCount;
+  unlockCache;
+  startJobs();
+  perform();
+
+  // on a fast connection the transfer may be complete already, and
+  // waiting for more would only delay the caller
+  lockCache;
+  done = loadCount != n || activeJobs.empty();
+  unlockCache;
+  if (done) {
+    return;
+  }
+#if LIBCURL_VERSION_NUM >= 0x074200
+  curl_multi_poll(multi, NULL, 0, curlCacheWaitTimeout, NULL);
+#else
+  curl_multi_wait(multi, NULL, 0, curlCacheWaitTimeout, NULL);
+#endif
+  perform();
+}
+
+void CurlCache::startJobs() {
+  CurlCacheJob *ccj;
+  CURL *curl;
+
+  for (;;) {
+    lockCache;
+    if (pendingJobs.empty() || (int)activeJobs.size() >= maxConnections) {
+      unlockCache;
+      break;
+    }
+    ccj = pendingJobs.front();
+    pendingJobs.pop_front();
+    unlockCache;
+
+    if (idleHandles.empty()) {
+      curl = curl_easy_init();
+    } else {
+      curl = idleHandles.back();
+      idleHandles.pop_back();
+    }
+    ccj->setup(curl);
+    curl_multi_add_handle(multi, curl);
+    activeJobs.push_back(ccj);
+    lockCache;
+    ++stats.requests;
+    stats.bytesRequested += ccj->getRequestedBytes();
+    unlockCache;
+  }
+}
+
+void CurlCache::perform() {
+  CURLMsg *msg;
+  int n;
+
+  curl_multi_perform(multi, &n);
+  while ((msg = curl_multi_info_read(multi, &n))) {
+    if (msg->msg == CURLMSG_DONE) {
+      CurlCacheJob *ccj;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&ccj);
+      finishJob(ccj, msg->data.result);
+    }
+  }
+  startJobs();
+}
+
+void CurlCache::finishJob(CurlCacheJob *ccj, CURLcode result) {
+  CURL *curl = ccj->getHandle();
+  std::vector<CurlCacheRange>::iterator r;
+  GBool ok, complete;
+  int i;
+
+  countRequest(curl);
+  ok = result == CURLE_OK && ccj->status == (ccj->isWhole() ? 200 : 206);
+  // a download that got to the end brings the chunks that were given to
+  // it too late with the next one
+  complete = ok && ccj->isWhole() && ccj->getCurrentByte() >= (size_t)size;
+  if (!ccj->needsFallback() && !ccj->rangesIgnored()) {
+    if (!ok) {
+      error(-1, "Couldn't load chunks %d-%d of '%s' (curl error %d, HTTP status %ld)",
+	    ccj->getStartBlock(), ccj->getEndBlock(), url->getCString(),
+	    (int)result, ccj->status);
+      lockCache;
+      ++errors;
+      unlockCache;
+    } else {
+      addTimingSample(curl);
+    }
+  }
+
+  lockCache;
+  if (ccj->needsFallback()) {
+    // the server ignored the extra ranges, don't send any more of them
+    multiRange = gFalse;
+  }
+  if (ccj->rangesIgnored()) {
+    startStreaming();
+  }
+  if (streamJob == ccj) {
+    streamJob = NULL;
+  }
+
+  // anything the job did not deliver has to be requested again; the
+  // merged gaps may by now belong to other jobs
+  for (r = ccj->ranges.begin(); r != ccj->ranges.end(); ++r) {
+    for (i = r->startBlock; i <= r->endBlock; ++i) {
+      if (chunks->get(i)->state == cccStateLoading &&
+	  chunks->get(i)->job == ccj) {
+	chunks->get(i)->state = cccStateNew;
+	chunks->freeData(i);
+	if (complete) {
+	  streamChunks(i, i);
+	}
+      }
+    }
+    if (ccj->needsFallback() || ccj->rangesIgnored()) {
+      scheduleChunks(r->startBlock, r->endBlock);
+    }
+  }
+  signalCache;
+  unlockCache;
+
+  curl_multi_remove_handle(multi, curl);
+  curl_easy_reset(curl);
+  idleHandles.push_back(curl);
+  activeJobs.remove(ccj);
+  delete ccj;
+}
+
+// Store the chunks that <data>, starting at file offset <start>,
+// covers completely.
+void CurlCache::seedChunks(size_t start, GooString *data) {
+  size_t end = start + data->getLength();
+  int chunk;
+
+  if (end > (size_t)size) {
+    end = size;
+  }
+  lockCache;
+  for (chunk = (start + chunkSize - 1) / chunkSize;
+       chunk < chunks->getNumChunks() &&
+	 (size_t)chunk * chunkSize + chunkLength(chunk) <= end;
+       ++chunk) {
+    if (chunks->get(chunk)->state != cccStateNew) {
+      continue;
+    }
+    memcpy(chunks->getData(chunk),
+	   data->getCString() + ((size_t)chunk * chunkSize - start),
+	   chunkLength(chunk));
+    chunkLoaded(chunk);
+  }
+  unlockCache;
+}
+
+// Collect the size and the validators from the opening response.
+size_t CurlCache::openHeader(char *ptr, size_t size, size_t nmemb, CurlCacheOpen *cco) {
+  size_t n = size*nmemb;
+  GooString h(ptr, (int)n);
+  GooString **v = NULL;
+  size_t first, last;
+  char *p;
+
+  while (h.getLength() > 0 &&
+	 (h.getChar(h.getLength()-1) == '\r' || h.getChar(h.getLength()-1) == '\n')) {
+    h.del(h.getLength()-1);
+  }
+  p = h.getCString();
+
+  if (!strncmp(p, "HTTP/", 5)) {
+    // only the final response after redirects counts
+    delete cco->etag;
+    delete cco->lastModified;
+    cco->etag = cco->lastModified = NULL;
+    cco->status = 0;
+    sscanf(p, "HTTP/%*s %ld", &cco->status);
+    cco->total = -1;
+    cco->first = 0;
+    cco->data->clear();
+  } else if (!strncasecmp(p, "Content-Range:", 14)) {
+    if (parseContentRange(p + 14, &first, &last)) {
+      cco->first = first;
+    }
+    cco->total = parseContentRangeLength(p + 14);
+  } else if (!strncasecmp(p, "Content-Length:", 15)) {
+    // the size of the document unless this is a partial response
+    if (cco->status == 200) {
+      sscanf(p + 15, "%ld", &cco->total);
+    }
+  } else if (!strncasecmp(p, "ETag:", 5)) {
+    v = &cco->etag;
+    p += 5;
+  } else if (!strncasecmp(p, "Last-Modified:", 14)) {
+    v = &cco->lastModified;
+    p += 14;
+  }
+  if (v) {
+    while (*p == ' ' || *p == '\t') ++p;
+    delete *v;
+    *v = *p ? new GooString(p) : (GooString *)NULL;
+  }
+  return n;
+}
+
+// Keep the body of the opening response.  A server that ignores the
+// range sends the whole document with a 200; that is only kept if it is
+// no larger than the tail we asked for.
+size_t CurlCache::openWrite(void *ptr, size_t size, size_t nmemb, CurlCacheOpen *cco) {
+  size_t n = size*nmemb;
+
+  if (cco->status != 200 && cco->status != 206) {
+    return n;
+  }
+  if (cco->data->getLength() + n > cco->maxData) {
+    cco->data->clear();
+    return 0;
+  }
+  cco->data->append((char *)ptr, (int)n);
+  return n;
 }
 
 //------------------------------------------------------------------------
 
-CurlCacheJob::CurlCacheJob(CurlCache *ccA, int startBlockA, int endBlockA) {
-  //printf("Getting blocks %i to %i\n", startBlockA, endBlockA);
+CurlCacheJob::CurlCacheJob(CurlCache *ccA, int startBlockA, int endBlockA,
+			   GBool wholeA) {
   cc = ccA;
-  startBlock = startBlockA;
-  endBlock = endBlockA;
+  curl = NULL;
+  fallback = gFalse;
+  ignored = gFalse;
+  whole = wholeA;
+  status = 0;
+  requestedBytes = 0;
+  currentByte = (size_t)startBlockA * cc->chunkSize;
+  boundary = NULL;
+  partRange = gFalse;
+  line = NULL;
+  addRange(startBlockA, endBlockA);
+}
+
+CurlCacheJob::~CurlCacheJob() {
+  delete boundary;
+  delete line;
+}
+
+void CurlCacheJob::addRange(int startBlockA, int endBlockA) {
+  CurlCacheRange r;
+
+  r.startBlock = startBlockA;
+  r.endBlock = endBlockA;
+  ranges.push_back(r);
 }
 
-void CurlCacheJob::run() {
-  size_t fromByte = startBlock * curlCacheChunkSize;
-  size_t toByte = ((endBlock+1) * curlCacheChunkSize)-1;
-  
-  if (toByte >= cc->size-1) {
-    toByte = cc->size-1;
+void CurlCacheJob::setup(CURL *curlA) {
+  std::vector<CurlCacheRange>::iterator r;
+  GooString *range = new GooString();
+
+  requestedBytes = 0;
+  for (r = ranges.begin(); r != ranges.end(); ++r) {
+    size_t fromByte = (size_t)r->startBlock * cc->chunkSize;
+    size_t toByte = ((size_t)(r->endBlock+1) * cc->chunkSize)-1;
+
+    if (cc->size > 0 && toByte >= (size_t)cc->size - 1) {
+      toByte = (size_t)cc->size - 1;
+    }
+    requestedBytes += toByte - fromByte + 1;
+    if (r != ranges.begin()) {
+      range->append(',');
+    }
+    range->appendf("{0:uld}-{1:uld}", (unsigned long)fromByte,
+		   (unsigned long)toByte);
   }
-  
-  GooString *range = GooString::format("{0:ud}-{1:ud}", fromByte, toByte);
-  //printf("Range: %s\n", range->getCString());
 
-  currentByte = fromByte;
+  curl = curlA;
+  currentByte = (size_t)ranges.front().startBlock * cc->chunkSize;
+  partEnd = cc->size - 1;
 
-  curl_easy_setopt(cc->curl, CURLOPT_URL, cc->url->getCString());
-  curl_easy_setopt(cc->curl, CURLOPT_WRITEFUNCTION, &CurlCacheJob::write);
-  curl_easy_setopt(cc->curl, CURLOPT_WRITEDATA, this);
-  curl_easy_setopt(cc->curl, CURLOPT_RANGE, range->getCString());
-  curl_easy_perform(cc->curl);
-  curl_easy_reset(cc->curl);
+  curl_easy_setopt(curl, CURLOPT_URL, cc->url->getCString());
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &CurlCacheJob::header);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, this);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &CurlCacheJob::write);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, this);
+  if (!whole) {
+    curl_easy_setopt(curl, CURLOPT_RANGE, range->getCString());
+  }
+  delete range;
 }
 
-size_t CurlCacheJob::write(void *ptr, size_t size, size_t nmemb, CurlCacheJob *ccj) {
-  //printf("%u bytes received\n", size*nmemb);
-  size_t toCopy = size*nmemb;
-  
+size_t CurlCacheJob::header(char *ptr, size_t size, size_t nmemb, CurlCacheJob *ccj) {
+  size_t n = size*nmemb;
+  GooString h(ptr, (int)n);
+  char *p;
+  size_t first, last;
+
+  // strip the line break
+  while (h.getLength() > 0 &&
+	 (h.getChar(h.getLength()-1) == '\r' || h.getChar(h.getLength()-1) == '\n')) {
+    h.del(h.getLength()-1);
+  }
+  p = h.getCString();
+
+  if (!strncmp(p, "HTTP/", 5)) {
+    // a new response (e.g. after a redirect) starts
+    ccj->status = 0;
+    sscanf(p, "HTTP/%*s %ld", &ccj->status);
+    delete ccj->boundary;
+    ccj->boundary = NULL;
+  } else if (!strncasecmp(p, "Content-Range:", 14)) {
+    if (parseContentRange(p + 14, &first, &last)) {
+      if (first % ccj->cc->chunkSize) {
+	// we only ever ask for whole chunks; fail the job so that its
+	// chunks are requested again
+	return 0;
+      }
+      ccj->currentByte = first;
+      ccj->partEnd = last;
+    }
+  } else if (!strncasecmp(p, "Content-Type:", 13)) {
+    GooString *lc = h.copy()->lowerCase();
+    char *m = strstr(lc->getCString(), "multipart/byteranges");
+    char *b = strstr(lc->getCString(), "boundary=");
+
+    if (m && b) {
+      b = p + (b - lc->getCString()) + 9;
+      if (*b == '"') {
+	++b;
+      }
+      delete ccj->boundary;
+      ccj->boundary = new GooString("--");
+      while (*b && *b != '"' && *b != ';' && *b != ' ') {
+	ccj->boundary->append(*b++);
+      }
+      ccj->partState = ccjPartHeader;
+      ccj->partRange = gFalse;
+      delete ccj->line;
+      ccj->line = new GooString();
+    }
+    delete lc;
+  }
+  return n;
+}
+
+// Store body bytes at currentByte.  This runs in the thread driving the
+// transfers, which is the only one writing chunk data, so the copy
+// itself doesn't need the lock.
+void CurlCacheJob::store(char *ptr, size_t toCopy) {
+  CurlCacheChunkState state;
+  char *data;
+
   while (toCopy) {
-    int chunk = ccj->currentByte / curlCacheChunkSize;
-    int offset = ccj->currentByte % curlCacheChunkSize;
-  
-    size_t len = curlCacheChunkSize-offset;
-  
+    int chunk = currentByte / cc->chunkSize;
+    int offset = currentByte % cc->chunkSize;
+
+    size_t len = cc->chunkSize-offset;
+
     if (len > toCopy)
       len = toCopy;
 
-    //printf("Writing Chunk %i, offset %i, len %i\n", chunk, offset, len);
-    memcpy(&ccj->cc->chunks[chunk].data[offset], ptr, len);
-    ccj->currentByte += len;
+    if (chunk >= cc->chunks->getNumChunks()) {
+      break;
+    }
+
+    // the buffer of a loading chunk stays where it is until the chunk
+    // is loaded or its job is finished
+#if MULTITHREADED
+    gLockMutex(&cc->mutex);
+#endif
+    state = cc->chunks->get(chunk)->state;
+    data = state == cccStateLoading ? cc->chunks->getData(chunk) : (char *)NULL;
+#if MULTITHREADED
+    gUnlockMutex(&cc->mutex);
+#endif
+
+    // only fill chunks this request was scheduled for, others are
+    // already in use or may have been evicted halfway through
+    if (state == cccStateLoading) {
+      memcpy(data + offset, ptr, len);
+
+      // other requests may be waiting on this chunk, so only publish it
+      // once it is complete
+      if (offset + len == (size_t)cc->chunkSize ||
+	  currentByte + len >= (size_t)cc->size) {
+#if MULTITHREADED
+	gLockMutex(&cc->mutex);
+#endif
+	cc->chunkLoaded(chunk);
+#if MULTITHREADED
+	gUnlockMutex(&cc->mutex);
+#endif
+      }
+    }
+    currentByte += len;
     toCopy -= len;
-    ptr = (char*)ptr + len;
-    
-    ccj->cc->chunks[chunk].state = cccStateLoaded;
+    ptr += len;
+  }
+}
+
+// Read one line of multipart framing (boundary or part header).  Returns
+// false if the part is malformed.
+GBool CurlCacheJob::readPartLine() {
+  char *p;
+  size_t first, last;
+
+  while (line->getLength() > 0 &&
+	 (line->getChar(line->getLength()-1) == '\r' ||
+	  line->getChar(line->getLength()-1) == '\n')) {
+    line->del(line->getLength()-1);
+  }
+  p = line->getCString();
+
+  if (!line->cmpN(boundary, boundary->getLength())) {
+    if (!strcmp(p + boundary->getLength(), "--")) {
+      partState = ccjPartDone;
+    }
+    partRange = gFalse;
+  } else if (!strncasecmp(p, "Content-Range:", 14)) {
+    if (!parseContentRange(p + 14, &first, &last)) {
+      return gFalse;
+    }
+    currentByte = first;
+    partEnd = last;
+    partRange = gTrue;
+  } else if (line->getLength() == 0 && partRange) {
+    // blank line after the part headers
+    if (currentByte % cc->chunkSize) {
+      // we only ever ask for whole chunks
+      return gFalse;
+    }
+    partState = ccjPartData;
+    partRange = gFalse;
   }
-  
+  line->clear();
+  return gTrue;
+}
+
+size_t CurlCacheJob::write(void *ptr, size_t size, size_t nmemb, CurlCacheJob *ccj) {
+  size_t toCopy = size*nmemb;
+  char *p = (char *)ptr;
+
+  if (ccj->whole) {
+    // the document from its first byte
+    if (ccj->status != 200) {
+      return 0;
+    }
+    ccj->store(p, toCopy);
+    return size*nmemb;
+  }
+
+  if (ccj->status != 206) {
+    if (ccj->status == 200) {
+      // the server ignores ranges, the chunks have to come from a
+      // download of the whole document
+      ccj->ignored = gTrue;
+    }
+    // abort, we can't use a full or error response here
+    return 0;
+  }
+
+  if (!ccj->boundary) {
+    // a single part, either what we asked for or the server merged
+    // all ranges into one
+    if (ccj->getNumRanges() > 1) {
+      ccj->fallback = gTrue;
+    }
+    if (ccj->currentByte + toCopy > ccj->partEnd + 1) {
+      // more data than announced
+      return 0;
+    }
+    ccj->store(p, toCopy);
+    return size*nmemb;
+  }
+
+  while (toCopy && ccj->partState != ccjPartDone) {
+    if (ccj->partState == ccjPartData) {
+      size_t len = ccj->partEnd + 1 - ccj->currentByte;
+      if (len > toCopy) {
+	len = toCopy;
+      }
+      ccj->store(p, len);
+      p += len;
+      toCopy -= len;
+      if (ccj->currentByte > ccj->partEnd) {
+	ccj->partState = ccjPartHeader;
+      }
+    } else {
+      char c = *p++;
+      --toCopy;
+      ccj->line->append(c);
+      if (c == '\n' && !ccj->readPartLine()) {
+	return 0;
+      }
+    }
+  }
+
   return size*nmemb;
 }
 
@@ -24,73 +24,415 @@
 #include "poppler-config.h"
 #include "goo/gtypes.h"
 #include "goo/GooString.h"
+#include "NetStats.h"
 
+#include <sys/select.h>
 #include <curl/curl.h>
 
-#include <map>
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
+#include <list>
+#include <vector>
+
+class CurlCache;
+class CurlCacheJob;
+class CurlDiskCache;
 
 //------------------------------------------------------------------------
 
-#define curlCacheChunkSize 8192
+// Default granularity of the cache, and the smallest one allowed.
+#define curlCacheDefaultChunkSize 8192
+#define curlCacheMinChunkSize 512
+
+// The document is opened with requests for this many chunks at its
+// start and at its end, which is where the trailer and usually the xref
+// table are.
+#define curlCacheHeadChunks 2
+#define curlCacheTailChunks 2
+
+// Maximum number of ranges sent in one multi-range request.
+#define curlCacheMaxRanges 32
+
+// Network timing assumed for a host before anything was measured.
+#define curlCacheDefaultRtt 0.05
+#define curlCacheDefaultThroughput (1024.0 * 1024.0)
+
+// Upper limit for the gap of loaded data that is downloaded again to
+// merge two ranges.
+#define curlCacheMaxMergeGap (1024 * 1024)
+
+// Documents up to this size are downloaded in one piece.
+#define curlCacheStreamSize (256 * 1024)
+
+// How long the thread driving the transfers sleeps at most before it
+// looks for new work (milliseconds).
+#define curlCacheWaitTimeout 100
 
 enum CurlCacheChunkState {
   cccStateNew,
-// If we want this to be thread-safe, concurrent, whatever, we need another state:
-// cccStateLoading,
+  cccStateLoading,		// a job covering this chunk is queued or running
   cccStateLoaded
 };
 
+// Fewest chunks kept in memory, whatever the memory limit is.
+#define curlCacheMinChunks 64
+
+// Number of chunk buffers the arena allocates at once.
+#define curlChunkSlabSize 64
+
 typedef struct {
   CurlCacheChunkState state;
-  char data[curlCacheChunkSize];
+  int pins;			// chunk must not be evicted while > 0
+  GBool referenced;		// read since the clock hand last passed
+  GBool used;			// read at least once
+  int slot;			// arena slot holding the data, -1 if none
+  CurlCacheJob *job;		// job requested for the chunk, only valid
+				//   while it is loading
 } CurlCacheChunk;
 
+//------------------------------------------------------------------------
+// CurlChunkTable
+//
+// Dense index of all chunks of a document of known size.  The chunk
+// data lives in slabs of curlChunkSlabSize buffers; slots of evicted
+// chunks are reused before a new slab is allocated.
+//------------------------------------------------------------------------
+
+class CurlChunkTable {
+public:
+
+  CurlChunkTable(int nChunksA, int chunkSizeA);
+  ~CurlChunkTable();
+
+  int getNumChunks() { return nChunks; }
+  int getChunkSize() { return chunkSize; }
+
+  // Bookkeeping for chunk <i>, 0 <= i < getNumChunks().
+  CurlCacheChunk *get(int i) { return &chunks[i]; }
+
+  // Buffer of chunk <i>.  A slot is assigned on first use.
+  char *getData(int i)
+    { if (chunks[i].slot < 0) allocSlot(i);
+      return slabs[chunks[i].slot / curlChunkSlabSize] +
+	     (chunks[i].slot % curlChunkSlabSize) * chunkSize; }
+
+  // Give the buffer of chunk <i> back to the arena.
+  void freeData(int i);
+
+  // Number of chunks that hold a buffer.
+  int getNumBuffers() { return nUsed; }
+
+private:
+
+  void allocSlot(int i);
+
+  CurlCacheChunk *chunks;
+  int nChunks;
+  int chunkSize;
+  char **slabs;
+  int nSlabs;
+  int *freeSlots;		// stack of unused slots
+  int nFree;
+  int nUsed;
+};
+
+// State of a request that opens a document.
+struct CurlCacheOpen {
+  CurlCache *cc;
+  CURL *curl;
+  GBool done;
+  GooString *range;
+  long status;			// HTTP status of the final response
+  long total;			// document size the server announced
+  size_t first;			// file offset of the body
+  GooString *data;		// body, up to maxData bytes
+  size_t maxData;
+  GooString *etag;		// validators of the response
+  GooString *lastModified;
+};
+
+//------------------------------------------------------------------------
+// CurlCache
+//------------------------------------------------------------------------
+
+// A CurlCache may be shared by several threads.  Only one of them at a
+// time drives the curl transfers, the others wait until the chunks they
+// need are loaded or the driving thread returns.
 class CurlCache {
 public:
 
   friend class CurlCacheJob;
 
-  CurlCache(GooString *urlA);
+  // Start loading <urlA>.  Unless <wait> is false, this returns once
+  // the size of the document is known; otherwise work() has to be
+  // called until isOpen() is true, and nothing else may be used before.
+  CurlCache(GooString *urlA, GBool wait = gTrue);
   ~CurlCache();
-  
+
+  // Is the size of the document known?
+  GBool isOpen() { return !opening; }
+
   GooString *getFileName();
-  
-  long int tell();
-  int seek(long int offset, int origin);
-  size_t read(void * ptr, size_t unitsize, size_t count);
+
+  // Size of the remote file.
+  size_t getLength() { return size; }
+
+  // Granularity in which data is requested and kept.  This is fixed
+  // when the cache is created (GlobalParams::setHttpChunkSize).
+  int getChunkSize() { return chunkSize; }
+
+  // Copy <len> bytes starting at <offset> into <buf>, loading them
+  // first if necessary.  Returns the number of bytes copied, which is
+  // less than <len> at the end of the file or if loading failed.
+  size_t readAt(size_t offset, void *buf, size_t len);
+
+  // Issue requests for all missing chunks in [start, end) without
+  // waiting for them to arrive.
   void preload(size_t start, size_t end);
-  
-  void loadChunks(int startBlock, int endBlock);
+
+  // Same for several ranges, which are requested together: the gaps
+  // go into as few multi-range requests as possible.  The ranges
+  // should be sorted by offset.
+  void preload(int nRanges, size_t *starts, size_t *ends);
+
+  // Issue requests for all missing chunks in [startBlock, endBlock] and
+  // wait until they are loaded.  Returns false if a request failed.
+  GBool loadChunks(int startBlock, int endBlock);
+
+  // Keep the chunks covering [start, end) in memory until they are
+  // unpinned again.  Calls nest.
+  void pin(size_t start, size_t end);
+  void unpin(size_t start, size_t end);
+
+  // Loaded chunks are evicted, least recently used first, once the
+  // cache holds more than this many bytes.  0 means no limit.
+  size_t getMaxMemory() { return maxMemory; }
+  void setMaxMemory(size_t maxMemoryA);
+
+  // Maximum number of requests that are in flight at the same time.
+  int getMaxConnections() { return maxConnections; }
+  void setMaxConnections(int maxConnectionsA);
+
+  // Whether several gaps may be requested in a single multi-range
+  // request.  This is switched off automatically if the server does not
+  // answer with multipart/byteranges.
+  GBool getMultiRange() { return multiRange; }
+  void setMultiRange(GBool multiRangeA) { multiRange = multiRangeA; }
+
+  // Two missing runs are requested as one range if the loaded data
+  // between them is no larger than this many bytes, i.e. when
+  // downloading it again is cheaper than an extra range.  This is the
+  // amount of data the host transfers in one round trip.
+  size_t getMergeGap();
+
+  // In adaptive mode a request for a few chunks is extended with the
+  // following missing ones until it is as large as the bandwidth-delay
+  // product, while data is still tracked per chunk.
+  GBool getAdaptive() { return adaptive; }
+  void setAdaptive(GBool adaptiveA) { adaptive = adaptiveA; }
+  size_t getMinRequestSize();
+
+  // Measured request round trip time (seconds) and transfer rate
+  // (bytes per second) for this host.
+  double getRtt() { return rtt; }
+  double getThroughput() { return throughput; }
+
+  // In non-blocking mode readAt does not wait for missing chunks: it
+  // requests them and returns the data up to the first one that is
+  // missing, counting a miss.  This is meant for a single thread that
+  // drives the transfers with work() from an event loop.
+  GBool getBlocking() { return blocking; }
+  void setBlocking(GBool blockingA) { blocking = blockingA; }
+  int getMisses() { return misses; }
+
+  // Number of requests that failed.
+  int getErrors() { return errors; }
+
+  // In streaming mode the document is downloaded whole with plain GET
+  // requests, and its chunks become available in order as the data
+  // arrives.  This is used for small documents and for servers that
+  // answer range requests with the whole document.
+  GBool getStreaming() { return streaming; }
+
+  // Move the transfers along without waiting, and call the data callback
+  // if chunks arrived.
+  void work();
+
+  // File descriptors and timeout (milliseconds, -1 if none) to wait for
+  // before calling work() again, see curl_multi_fdset and
+  // curl_multi_timeout.
+  void getFdSet(fd_set *readFds, fd_set *writeFds, fd_set *excFds,
+		int *maxFd);
+  long getTimeout();
+
+  // No request is queued or in flight.
+  GBool isIdle();
+
+  // <cbk> is called from work() whenever new data is available.
+  void setDataCallback(void (*cbk)(void *data), void *data)
+    { dataCbk = cbk; dataCbkData = data; }
+
+  // Traffic counters of this document so far.
+  void getStats(NetStats *statsA);
+
+  // Validators the server sent for the document, NULL if none.
+  GooString *getETag() { return etag; }
+  GooString *getLastModified() { return lastModified; }
 
 private:
 
-  CURL *curl;
+  // These are called with the cache locked.  scheduleChunks adds the
+  // missing runs to <ccj> while there is room and returns the last job
+  // it used.
+  CurlCacheJob *scheduleChunks(int startBlock, int endBlock,
+			       CurlCacheJob *ccj = NULL);
+  GBool waitForChunks(int startBlock, int endBlock);
+  int loadedGap(int block, int endBlock);
+  int chunkLength(int chunk);
+  void chunkLoaded(int chunk);
+  void pinChunks(int startBlock, int endBlock, int delta);
+  void evictChunks();
+  void startStreaming();
+  void streamChunks(int startBlock, int endBlock);
+
+  // These are only called by the thread driving the transfers, with the
+  // cache unlocked.
+  void drive();
+  void startJobs();
+  void perform();
+  void finishJob(CurlCacheJob *ccj, CURLcode result);
+  void addTimingSample(CURL *curl);
+  void countRequest(CURL *curl);
+  void startOpen();
+  void setupOpen(CurlCacheOpen *cco, GooString *range, size_t maxData);
+  void performOpen();
+  void finishOpen(CurlCacheOpen *cco, CURLcode result);
+  void openDone();
+  void seedChunks(size_t start, GooString *data);
+
+  CURLM *multi;
   GooString *url;
   long int size;
-  long int streamPos;
-  
-  std::map<unsigned, CurlCacheChunk> chunks;
-  
-  static size_t noop(void *ptr, size_t size, size_t nmemb, void *ptr2);
+  int chunkSize;
+  GBool adaptive;
+  int maxConnections;
+  GBool multiRange;
+  GooString *host;		// scheme, host and port part of url
+  double rtt;
+  double throughput;
+  GooString *etag;
+  GooString *lastModified;
+  CurlDiskCache *diskCache;	// persistent chunk store, NULL if disabled
+
+  GBool opening;			// the opening requests are running
+  CurlCacheOpen openReqs[2];	// first chunks and tail
+  struct curl_slist *openConditions;
+
+  GBool streaming;
+  CurlCacheJob *streamJob;	// latest whole-document download, NULL if
+				//   none is queued or running
+  GBool blocking;
+  int misses;			// reads that found missing chunks
+  int errors;			// failed requests
+  int loadCount;		// chunks loaded so far
+  void (*dataCbk)(void *data);
+  void *dataCbkData;
+  NetStats stats;		// failedRequests is taken from errors
+
+  CurlChunkTable *chunks;
+  size_t maxMemory;
+  int clockHand;		// next chunk the eviction looks at
+
+  std::vector<CURL *> idleHandles;	// easy handles not attached to a job
+  std::list<CurlCacheJob *> pendingJobs;	// jobs waiting for a connection
+  std::list<CurlCacheJob *> activeJobs;	// jobs attached to the multi handle
+  GBool driving;			// a thread is driving the transfers
+
+#if MULTITHREADED
+  GooMutex mutex;		// protects everything except the curl
+				//   handles and activeJobs
+  GooCond chunkCond;		// signalled when a chunk changes state or
+				//   driving is released
+#endif
+
+  static size_t openHeader(char *ptr, size_t size, size_t nmemb, CurlCacheOpen *cco);
+  static size_t openWrite(void *ptr, size_t size, size_t nmemb, CurlCacheOpen *cco);
 
 };
 
+struct CurlCacheRange {
+  int startBlock;
+  int endBlock;
+};
+
+enum CurlCacheJobPartState {
+  ccjPartHeader,		// reading multipart boundary or part headers
+  ccjPartData,			// reading the body of a part
+  ccjPartDone			// closing boundary seen
+};
+
 class CurlCacheJob {
 public:
 
-  CurlCacheJob(CurlCache *ccA, int startBlockA, int endBlockA);
-  
-  void run();
+  // A <wholeA> job downloads the whole document without a range; it
+  // fills the chunks assigned to it as it passes them.
+  CurlCacheJob(CurlCache *ccA, int startBlockA, int endBlockA,
+	       GBool wholeA = gFalse);
+  ~CurlCacheJob();
+
+  // Request another run of chunks in the same request.  Several runs are
+  // sent as a single multi-range request.
+  void addRange(int startBlockA, int endBlockA);
+  int getNumRanges() { return (int)ranges.size(); }
+
+  // Configure <curlA> for this job's byte ranges.
+  void setup(CURL *curlA);
+
+  CURL *getHandle() { return curl; }
+  int getStartBlock() { return ranges.front().startBlock; }
+  // Number of bytes the ranges cover, valid after setup().
+  size_t getRequestedBytes() { return requestedBytes; }
+  int getEndBlock() { return ranges.back().endBlock; }
+
+  // Returns true if the server answered a multi-range request with a
+  // single body, and the missing ranges have to be requested one by one.
+  GBool needsFallback() { return fallback; }
+
+  // Returns true if the server answered the ranges with the whole
+  // document.
+  GBool rangesIgnored() { return ignored; }
+
+  GBool isWhole() { return whole; }
+
+  // File offset of the next byte that arrives.
+  size_t getCurrentByte() { return currentByte; }
 
 private:
 
+  void store(char *ptr, size_t len);
+  GBool readPartLine();
+
   CurlCache *cc;
-  int startBlock;
-  int endBlock;
-  int currentByte;
-  
+  CURL *curl;
+  std::vector<CurlCacheRange> ranges;
+  size_t requestedBytes;
+  size_t currentByte;		// file offset of the next body byte
+  size_t partEnd;		// last byte of the current part
+  GBool fallback;
+  GBool ignored;
+  GBool whole;
+  long status;			// HTTP status of the response
+  GooString *boundary;		// multipart boundary, NULL if not multipart
+  CurlCacheJobPartState partState;
+  GBool partRange;		// Content-Range of the current part seen
+  GooString *line;		// multipart framing line being read
+
+  static size_t header(char *ptr, size_t size, size_t nmemb, CurlCacheJob *ccj);
   static size_t write(void *ptr, size_t size, size_t nmemb, CurlCacheJob *ccj);
 
+  friend class CurlCache;
 };
 
 #endif
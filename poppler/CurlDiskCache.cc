@@ -0,0 +1,524 @@
+//========================================================================
+//
+// CurlDiskCache.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "CurlDiskCache.h"
+
+#ifdef ENABLE_LIBCURL
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#  include <direct.h>
+#else
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/file.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+#include "goo/gmem.h"
+#include "goo/gfile.h"
+#include "goo/GooString.h"
+#include "goo/GooList.h"
+#include "Error.h"
+
+//------------------------------------------------------------------------
+
+#define curlDiskCacheMagic "poppler-http-cache 1"
+
+// Longest URL or validator that is kept in the index.
+#define curlDiskCacheMaxLine 4096
+
+// FNV-1a hash of <s>, used to name the files of an entry.
+static Guint hashURL(GooString *s) {
+  Guint h = 2166136261u;
+  int i;
+
+  for (i = 0; i < s->getLength(); ++i) {
+    h ^= (Guchar)s->getChar(i);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// Read one index line into <buf> without the line end.
+static GBool readLine(char *buf, FILE *f) {
+  int n;
+
+  if (!getLine(buf, curlDiskCacheMaxLine, f)) {
+    return gFalse;
+  }
+  n = strlen(buf);
+  while (n > 0 && (buf[n-1] == '\n' || buf[n-1] == '\r')) {
+    buf[--n] = '\0';
+  }
+  return gTrue;
+}
+
+static void makeDir(GooString *dir) {
+#ifdef _WIN32
+  _mkdir(dir->getCString());
+#else
+  mkdir(dir->getCString(), 0700);
+#endif
+}
+
+static GBool sameString(GooString *s1, GooString *s2) {
+  return s1 ? (s2 && !s1->cmp(s2)) : !s2;
+}
+
+static int countBits(Guchar *bits, int n) {
+  int count, i;
+
+  count = 0;
+  for (i = 0; i < n; ++i) {
+    if (bits[i >> 3] & (1 << (i & 7))) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+// Create a new file with a unique name next to <path>, and return its
+// name in <tmpPath>.
+static FILE *createFile(GooString *path, GooString **tmpPath,
+			const char *mode) {
+  FILE *f;
+#if HAVE_MKSTEMP && !defined(_WIN32)
+  int fd;
+
+  *tmpPath = path->copy()->append(".XXXXXX");
+  if ((fd = mkstemp((*tmpPath)->getCString())) < 0) {
+    delete *tmpPath;
+    return NULL;
+  }
+  if (!(f = fdopen(fd, mode))) {
+    close(fd);
+    remove((*tmpPath)->getCString());
+    delete *tmpPath;
+  }
+  return f;
+#else
+  GooString *s;
+  int t, i;
+
+  t = (int)time(NULL);
+  for (i = 0; i < 1000; ++i) {
+    s = GooString::format("{0:t}.{1:d}", path, t + i);
+    if (!(f = fopen(s->getCString(), "r"))) {
+      if ((f = fopen(s->getCString(), mode))) {
+	*tmpPath = s;
+	return f;
+      }
+      delete s;
+      return NULL;
+    }
+    fclose(f);
+    delete s;
+  }
+  return NULL;
+#endif
+}
+
+// Move <tmpPath> to <path>.  Sessions that still have the old file
+// open go on reading it.
+static GBool replaceFile(GooString *tmpPath, GooString *path) {
+  if (!rename(tmpPath->getCString(), path->getCString())) {
+    return gTrue;
+  }
+#ifdef _WIN32
+  // rename() doesn't replace files on Windows, and open files can't be
+  // removed
+  if (!remove(path->getCString()) &&
+      !rename(tmpPath->getCString(), path->getCString())) {
+    return gTrue;
+  }
+#endif
+  remove(tmpPath->getCString());
+  return gFalse;
+}
+
+// Returns true if <path> still names the file that <f> has open.
+static GBool isFileAt(FILE *f, GooString *path) {
+#ifdef _WIN32
+  // open files can't be replaced on Windows
+  return gTrue;
+#else
+  struct stat st1, st2;
+
+  return !fstat(fileno(f), &st1) && !stat(path->getCString(), &st2) &&
+         st1.st_dev == st2.st_dev && st1.st_ino == st2.st_ino;
+#endif
+}
+
+//------------------------------------------------------------------------
+// CurlDiskCache
+//------------------------------------------------------------------------
+
+CurlDiskCache::CurlDiskCache(GooString *dirA, GooString *urlA,
+			     int chunkSizeA) {
+  char name[16];
+
+  dir = dirA->copy();
+  url = urlA->copy();
+  chunkSize = chunkSizeA;
+  etag = NULL;
+  lastModified = NULL;
+  size = -1;
+  nChunks = 0;
+  nStored = 0;
+  bitmap = NULL;
+
+  sprintf(name, "%08x", hashURL(url));
+  idxPath = appendToPath(dir->copy(), name);
+  idxPath->append(".idx");
+  dataPath = appendToPath(dir->copy(), name);
+  dataPath->append(".dat");
+
+  grown = gFalse;
+  dataFile = NULL;
+
+  makeDir(dir);
+  lockDir();
+  if (readIndex(&etag, &lastModified, &size, &bitmap)) {
+    nChunks = size > 0 ? (int)((size + chunkSize - 1) / chunkSize) : 0;
+    nStored = countBits(bitmap, nChunks);
+    dataFile = fopen(dataPath->getCString(), "r+b");
+  }
+  if (!dataFile) {
+    // no usable entry, start a new one
+    delete etag;
+    delete lastModified;
+    etag = lastModified = NULL;
+    reset(-1);
+    newDataFile();
+  }
+  unlockDir();
+}
+
+CurlDiskCache::~CurlDiskCache() {
+  if (dataFile) {
+    fclose(dataFile);
+  }
+  delete dir;
+  delete url;
+  delete idxPath;
+  delete dataPath;
+  delete etag;
+  delete lastModified;
+  gfree(bitmap);
+}
+
+// Read the index of the entry.  On success, the validators, the size
+// and a bitmap for that size are returned.
+GBool CurlDiskCache::readIndex(GooString **etagA, GooString **lastModifiedA,
+			       long *sizeA, Guchar **bitmapA) {
+  char buf[curlDiskCacheMaxLine];
+  GooString *etag1, *lastModified1;
+  Guchar *bitmap1;
+  long size1;
+  int chunkSize1, nStored1, n;
+  unsigned long lastUse;
+  FILE *f;
+
+  if (!(f = fopen(idxPath->getCString(), "rb"))) {
+    return gFalse;
+  }
+  if (!readLine(buf, f) || strcmp(buf, curlDiskCacheMagic) ||
+      !readLine(buf, f) || url->cmp(buf)) {
+    // different format or hash collision
+    fclose(f);
+    return gFalse;
+  }
+  etag1 = lastModified1 = NULL;
+  if (readLine(buf, f) && buf[0]) {
+    etag1 = new GooString(buf);
+  }
+  if (readLine(buf, f) && buf[0]) {
+    lastModified1 = new GooString(buf);
+  }
+  bitmap1 = NULL;
+  if (!readLine(buf, f) ||
+      sscanf(buf, "%ld %d %d %lu",
+	     &size1, &chunkSize1, &nStored1, &lastUse) != 4 ||
+      size1 < 0 || chunkSize1 != chunkSize) {
+    goto err;
+  }
+  n = size1 > 0 ? (int)((size1 + chunkSize - 1) / chunkSize) : 0;
+  n = (n + 7) >> 3;
+  bitmap1 = (Guchar *)gmalloc(n);
+  if ((int)fread(bitmap1, 1, n, f) != n) {
+    goto err;
+  }
+  fclose(f);
+  *etagA = etag1;
+  *lastModifiedA = lastModified1;
+  *sizeA = size1;
+  *bitmapA = bitmap1;
+  return gTrue;
+
+ err:
+  fclose(f);
+  delete etag1;
+  delete lastModified1;
+  gfree(bitmap1);
+  return gFalse;
+}
+
+// Start an empty data file, without truncating the old one: other
+// sessions may still be reading it.
+GBool CurlDiskCache::newDataFile() {
+  GooString *tmpPath;
+
+  if (dataFile) {
+    fclose(dataFile);
+  }
+  if (!(dataFile = createFile(dataPath, &tmpPath, "w+b"))) {
+    error(-1, "Couldn't create cache file '%s'", dataPath->getCString());
+    return gFalse;
+  }
+  if (!replaceFile(tmpPath, dataPath)) {
+    error(-1, "Couldn't create cache file '%s'", dataPath->getCString());
+    fclose(dataFile);
+    dataFile = NULL;
+  }
+  delete tmpPath;
+  return dataFile != NULL;
+}
+
+// The cache directory is locked while files of its entries are
+// replaced or removed.
+void CurlDiskCache::lockDir() {
+#ifdef _WIN32
+  lockFd = -1;
+#else
+  GooString *path;
+
+  path = appendToPath(dir->copy(), "lock");
+  if ((lockFd = open(path->getCString(), O_RDWR | O_CREAT, 0600)) >= 0) {
+    flock(lockFd, LOCK_EX);
+  }
+  delete path;
+#endif
+}
+
+void CurlDiskCache::unlockDir() {
+#ifndef _WIN32
+  if (lockFd >= 0) {
+    flock(lockFd, LOCK_UN);
+    close(lockFd);
+    lockFd = -1;
+  }
+#endif
+}
+
+void CurlDiskCache::reset(long sizeA) {
+  size = sizeA;
+  nChunks = size > 0 ? (int)((size + chunkSize - 1) / chunkSize) : 0;
+  nStored = 0;
+  bitmap = (Guchar *)grealloc(bitmap, (nChunks + 7) >> 3);
+  memset(bitmap, 0, (nChunks + 7) >> 3);
+}
+
+GBool CurlDiskCache::validate(long sizeA, GooString *etagA,
+			      GooString *lastModifiedA) {
+  if (!etagA && !lastModifiedA) {
+    return gFalse;
+  }
+  if (sizeA == size &&
+      ((etagA && etag && !etagA->cmp(etag)) ||
+       (!etagA && !etag && lastModifiedA && lastModified &&
+	!lastModifiedA->cmp(lastModified)))) {
+    return gTrue;
+  }
+
+  delete etag;
+  delete lastModified;
+  etag = etagA ? etagA->copy() : (GooString *)NULL;
+  lastModified = lastModifiedA ? lastModifiedA->copy() : (GooString *)NULL;
+  reset(sizeA);
+  lockDir();
+  newDataFile();
+  unlockDir();
+  return dataFile != NULL;
+}
+
+GBool CurlDiskCache::readChunk(int chunk, char *buf, int len) {
+  if (!dataFile || !hasChunk(chunk)) {
+    return gFalse;
+  }
+  if (fseek(dataFile, (long)chunk * chunkSize, SEEK_SET) ||
+      (int)fread(buf, 1, len, dataFile) != len) {
+    bitmap[chunk >> 3] &= ~(1 << (chunk & 7));
+    --nStored;
+    return gFalse;
+  }
+  return gTrue;
+}
+
+void CurlDiskCache::writeChunk(int chunk, char *buf, int len) {
+  if (!dataFile || chunk >= nChunks || hasChunk(chunk)) {
+    return;
+  }
+  if (fseek(dataFile, (long)chunk * chunkSize, SEEK_SET) ||
+      (int)fwrite(buf, 1, len, dataFile) != len) {
+    return;
+  }
+  bitmap[chunk >> 3] |= 1 << (chunk & 7);
+  ++nStored;
+  grown = gTrue;
+}
+
+void CurlDiskCache::flush() {
+  GooString *etag1, *lastModified1, *tmpPath;
+  Guchar *bitmap1;
+  long size1;
+  int i;
+  FILE *f;
+
+  if (!dataFile) {
+    return;
+  }
+  fflush(dataFile);
+
+  lockDir();
+
+  // another session replaced or removed the data file, this index
+  // doesn't describe it
+  if (!isFileAt(dataFile, dataPath)) {
+    unlockDir();
+    return;
+  }
+
+  // keep the chunks that other sessions stored in the same file
+  if (readIndex(&etag1, &lastModified1, &size1, &bitmap1)) {
+    if (size1 == size && sameString(etag1, etag) &&
+	sameString(lastModified1, lastModified)) {
+      for (i = 0; i < (nChunks + 7) >> 3; ++i) {
+	bitmap[i] |= bitmap1[i];
+      }
+      nStored = countBits(bitmap, nChunks);
+    }
+    delete etag1;
+    delete lastModified1;
+    gfree(bitmap1);
+  }
+
+  // the index is rewritten even if nothing changed, the time of last
+  // use decides what is evicted first; it is written to a new file so
+  // that readers never see half of it
+  if (!(f = createFile(idxPath, &tmpPath, "wb"))) {
+    error(-1, "Couldn't write cache index '%s'", idxPath->getCString());
+    unlockDir();
+    return;
+  }
+  fprintf(f, "%s\n%s\n%s\n%s\n%ld %d %d %lu\n", curlDiskCacheMagic,
+	  url->getCString(),
+	  etag ? etag->getCString() : "",
+	  lastModified ? lastModified->getCString() : "",
+	  size, chunkSize, nStored, (unsigned long)time(NULL));
+  fwrite(bitmap, 1, (nChunks + 7) >> 3, f);
+  if (fclose(f) || !replaceFile(tmpPath, idxPath)) {
+    error(-1, "Couldn't write cache index '%s'", idxPath->getCString());
+    remove(tmpPath->getCString());
+  }
+  delete tmpPath;
+  unlockDir();
+}
+
+//------------------------------------------------------------------------
+
+struct CurlDiskCacheEntry {
+  GooString *idxPath;
+  unsigned long lastUse;
+  Guint bytes;
+};
+
+static int cmpEntries(const void *p1, const void *p2) {
+  const CurlDiskCacheEntry *e1 = *(const CurlDiskCacheEntry **)p1;
+  const CurlDiskCacheEntry *e2 = *(const CurlDiskCacheEntry **)p2;
+
+  if (e1->lastUse < e2->lastUse) {
+    return -1;
+  }
+  return e1->lastUse > e2->lastUse ? 1 : 0;
+}
+
+void CurlDiskCache::trim(Guint maxSize) {
+  char buf[curlDiskCacheMaxLine];
+  GDir *gdir;
+  GDirEntry *ent;
+  GooList *entries;
+  CurlDiskCacheEntry *e, **sorted;
+  GooString *name, *dataPathA;
+  long sizeA;
+  int chunkSizeA, nStoredA, i;
+  unsigned long lastUse;
+  double total;
+  FILE *f;
+
+  lockDir();
+
+  // collect the entries from their index headers
+  entries = new GooList();
+  total = 0;
+  gdir = new GDir(dir->getCString(), gFalse);
+  while ((ent = gdir->getNextEntry())) {
+    name = ent->getName();
+    if (name->getLength() > 4 &&
+	!strcmp(name->getCString() + name->getLength() - 4, ".idx") &&
+	(f = fopen(ent->getFullPath()->getCString(), "rb"))) {
+      for (i = 0; i < 5 && readLine(buf, f); ++i) ;
+      if (i == 5 && sscanf(buf, "%ld %d %d %lu",
+			   &sizeA, &chunkSizeA, &nStoredA, &lastUse) == 4) {
+	e = new CurlDiskCacheEntry;
+	e->idxPath = ent->getFullPath()->copy();
+	// time stamps only have a resolution of seconds
+	e->lastUse = e->idxPath->cmp(idxPath) ? lastUse : (unsigned long)-1;
+	e->bytes = (Guint)nStoredA * chunkSizeA;
+	entries->append(e);
+	total += e->bytes;
+      }
+      fclose(f);
+    }
+    delete ent;
+  }
+  delete gdir;
+
+  // drop the least recently used ones
+  sorted = (CurlDiskCacheEntry **)gmallocn(entries->getLength(),
+					   sizeof(CurlDiskCacheEntry *));
+  for (i = 0; i < entries->getLength(); ++i) {
+    sorted[i] = (CurlDiskCacheEntry *)entries->get(i);
+  }
+  qsort(sorted, entries->getLength(), sizeof(CurlDiskCacheEntry *),
+	&cmpEntries);
+  for (i = 0; i < entries->getLength() && total > maxSize; ++i) {
+    e = sorted[i];
+    dataPathA = new GooString(e->idxPath, 0, e->idxPath->getLength() - 4);
+    dataPathA->append(".dat");
+    remove(e->idxPath->getCString());
+    remove(dataPathA->getCString());
+    delete dataPathA;
+    total -= e->bytes;
+  }
+  for (i = 0; i < entries->getLength(); ++i) {
+    delete sorted[i]->idxPath;
+    delete sorted[i];
+  }
+  gfree(sorted);
+  delete entries;
+
+  unlockDir();
+}
+
+#endif
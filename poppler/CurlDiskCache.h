@@ -0,0 +1,123 @@
+//========================================================================
+//
+// CurlDiskCache.h
+//
+// Persistent chunk store for CurlCache.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef CURLDISKCACHE_H
+#define CURLDISKCACHE_H
+
+#include <config.h>
+
+#ifdef ENABLE_LIBCURL
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stdio.h>
+#include <time.h>
+#include "goo/gtypes.h"
+
+class GooString;
+
+//------------------------------------------------------------------------
+// CurlDiskCache
+//
+// Each remote document gets two files in the cache directory, named
+// after a hash of its URL:
+//
+//   <hash>.dat  sparse copy of the document, every chunk that was
+//               downloaded is stored at its file offset
+//   <hash>.idx  URL, ETag, Last-Modified, size, chunk size, number of
+//               stored chunks and time of last use, one per line,
+//               followed by a bitmap of the stored chunks
+//
+// The index is only written by flush(), so a document that was not
+// closed properly looks older than it is.
+//
+// Several sessions, in one or more processes, may use the same entry.
+// Files are never truncated or rewritten in place: a stale data file
+// is replaced by a new one, and the index is written to a new file
+// that is renamed over the old one, so a session that still has the
+// old data file open goes on reading consistent data.  The cache
+// directory is locked while this happens.  flush() merges the chunks
+// that other sessions stored in the same data file, and leaves the
+// index alone if the data file it describes was replaced meanwhile.
+//------------------------------------------------------------------------
+
+class CurlDiskCache {
+public:
+
+  // Open or create the entry for <urlA> in <dirA>.
+  CurlDiskCache(GooString *dirA, GooString *urlA, int chunkSizeA);
+  ~CurlDiskCache();
+
+  // Returns true if the data file could be opened.
+  GBool isOk() { return dataFile != NULL; }
+
+  // Validators and size stored with the entry, NULL or -1 if there is
+  // no usable entry.
+  GooString *getETag() { return etag; }
+  GooString *getLastModified() { return lastModified; }
+  long getSize() { return size; }
+
+  // Check the entry against the current state of the document.  If
+  // the validators differ, all stored chunks are dropped and the new
+  // ones are remembered.  Returns false if the document has no
+  // validators at all, in which case it must not be cached.
+  GBool validate(long sizeA, GooString *etagA, GooString *lastModifiedA);
+
+  GBool hasChunk(int chunk)
+    { return chunk < nChunks && (bitmap[chunk >> 3] & (1 << (chunk & 7))); }
+
+  // Read <len> bytes of <chunk> into <buf>.  Returns false and forgets
+  // the chunk if it cannot be read back.
+  GBool readChunk(int chunk, char *buf, int len);
+
+  // Store <len> bytes of <chunk>.
+  void writeChunk(int chunk, char *buf, int len);
+
+  // Write the index and mark the entry as used now.
+  void flush();
+
+  // Returns true if chunks were stored since the entry was opened.
+  GBool hasGrown() { return grown; }
+
+  // Remove the least recently used entries of the cache directory
+  // until the stored chunks take no more than <maxSize> bytes.  This
+  // entry counts as the most recently used one.
+  void trim(Guint maxSize);
+
+private:
+
+  void reset(long sizeA);
+  GBool readIndex(GooString **etagA, GooString **lastModifiedA,
+		  long *sizeA, Guchar **bitmapA);
+  GBool newDataFile();
+  void lockDir();
+  void unlockDir();
+
+  GooString *dir;
+  GooString *url;
+  GooString *idxPath;
+  GooString *dataPath;
+  FILE *dataFile;
+  GooString *etag;		// NULL if none
+  GooString *lastModified;	// NULL if none
+  long size;			// -1 if unknown
+  int chunkSize;
+  int nChunks;
+  int nStored;			// number of bits set in bitmap
+  Guchar *bitmap;
+  GBool grown;			// set when a chunk is stored
+  int lockFd;			// lock file while the directory is locked
+};
+
+#endif
+
+#endif
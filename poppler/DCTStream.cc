@@ -18,7 +18,8 @@ static void str_init_source(j_decompress_ptr cinfo)
 
 static boolean str_fill_input_buffer(j_decompress_ptr cinfo)
 {
-  int c;
+  int c, n;
+  Guchar *span;
   struct str_src_mgr * src = (struct str_src_mgr *)cinfo->src;
   if (src->abort) return FALSE;
   if (src->index == 0) {
@@ -29,7 +30,22 @@ static boolean str_fill_input_buffer(j_decompress_ptr cinfo)
     c = 0xD8;
     src->index++;
   }
-  else c = src->str->getChar();
+  else {
+    // the decoder only asks for more once it has used up the whole of
+    // the last span; hand it whatever the stream has decoded already,
+    // rather than one byte per call
+    if (src->spanLen > 0) {
+      src->str->skipSpan(src->spanLen);
+      src->spanLen = 0;
+    }
+    if ((n = src->str->lookSpan(&span)) > 0) {
+      src->pub.next_input_byte = span;
+      src->pub.bytes_in_buffer = n;
+      src->spanLen = n;
+      return TRUE;
+    }
+    c = n < 0 ? src->str->getChar() : EOF;
+  }
   if (c != EOF)
   {
     src->buffer = c;
@@ -46,7 +62,8 @@ static void str_skip_input_data(j_decompress_ptr cinfo, long num_bytes)
   if (num_bytes > 0) {
     while (num_bytes > (long) src->pub.bytes_in_buffer) {
       num_bytes -= (long) src->pub.bytes_in_buffer;
-      str_fill_input_buffer(cinfo);
+      src->pub.bytes_in_buffer = 0;
+      if (!str_fill_input_buffer(cinfo)) return;
     }
     src->pub.next_input_byte += (size_t) num_bytes;
     src->pub.bytes_in_buffer -= (size_t) num_bytes;
@@ -86,6 +103,7 @@ void DCTStream::init()
   src.pub.next_input_byte = NULL;
   src.str = str;
   src.index = 0;
+  src.spanLen = 0;
   src.abort = false;
   current = NULL;
   limit = NULL;
@@ -100,6 +118,7 @@ void DCTStream::reset() {
   int row_stride;
 
   str->reset();
+  src.spanLen = 0;
 
   if (row_buffer)
   {
@@ -177,6 +196,38 @@ int DCTStream::lookChar() {
   return *current;
 }
 
+int DCTStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  for (n = 0; n < nChars && !src.abort; n += m) {
+    if (current == limit) {
+      if (cinfo.output_scanline >= cinfo.output_height ||
+	  !jpeg_read_scanlines(&cinfo, row_buffer, 1)) {
+	break;
+      }
+      current = &row_buffer[0][0];
+      limit = &row_buffer[0][(cinfo.output_width - 1) * cinfo.output_components] + cinfo.output_components;
+    }
+    m = (int)(limit - current);
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, current, m);
+    current += m;
+  }
+  return n;
+}
+
+Stream *DCTStream::getUndecodedStream() {
+  // callers go on reading the raw data where the image ends, so give
+  // back the part of the span the decoder hasn't used
+  if (src.spanLen > 0) {
+    str->skipSpan(src.spanLen - (int)src.pub.bytes_in_buffer);
+    src.spanLen = (int)src.pub.bytes_in_buffer;
+  }
+  return str->getUndecodedStream();
+}
+
 GooString *DCTStream::getPSFilter(int psLevel, char *indent) {
   GooString *s;
 
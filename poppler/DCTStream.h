@@ -48,6 +48,7 @@ struct str_src_mgr {
     JOCTET buffer;
     Stream *str;
     int index;
+    int spanLen;		// bytes of the buffer that are a span of str
     bool abort;
 };
 
@@ -61,6 +62,8 @@ public:
   virtual void reset();
   virtual int getChar();
   virtual int lookChar();
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual Stream *getUndecodedStream();
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
   Stream *getRawStream() { return str; }
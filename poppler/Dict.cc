@@ -40,11 +40,17 @@
 // Dict
 //------------------------------------------------------------------------
 
+static inline Guint hashKey(int keyAtom) {
+  return (Guint)keyAtom * 2654435761U;
+}
+
 Dict::Dict(XRef *xrefA) {
   xref = xrefA;
   entries = NULL;
   size = length = 0;
   ref = 1;
+  hashTab = NULL;
+  hashSize = 0;
 }
 
 Dict::Dict(Dict* dictA) {
@@ -54,22 +60,33 @@ Dict::Dict(Dict* dictA) {
 
   entries = (DictEntry *)gmallocn(size, sizeof(DictEntry));
   for (int i=0; i<length; i++) {
-    entries[i].key = strdup(dictA->entries[i].key);
+    entries[i].key = NameTable::copyName(dictA->entries[i].key);
     dictA->entries[i].val.copy(&entries[i].val);
   }
+  hashTab = NULL;
+  hashSize = 0;
+  if (length > dictHashThreshold) {
+    buildHash();
+  }
 }
 
 Dict::~Dict() {
   int i;
 
   for (i = 0; i < length; ++i) {
-    gfree(entries[i].key);
+    NameTable::freeName(entries[i].key);
     entries[i].val.free();
   }
   gfree(entries);
+  gfree(hashTab);
 }
 
 void Dict::add(char *key, Object *val) {
+  addName(NameTable::intern(key), val);
+  gfree(key);
+}
+
+void Dict::addName(char *key, Object *val) {
   if (length == size) {
     if (length == 0) {
       size = 8;
@@ -81,36 +98,109 @@ void Dict::add(char *key, Object *val) {
   entries[length].key = key;
   entries[length].val = *val;
   ++length;
+  if (hashTab) {
+    if (2 * length > hashSize) {
+      buildHash();
+    } else {
+      hashAdd(length - 1);
+    }
+  } else if (length > dictHashThreshold) {
+    buildHash();
+  }
 }
 
-inline DictEntry *Dict::find(char *key) {
+// Enter entries[<idx>] in the (open addressed) hash index.  A later
+// duplicate of a key replaces the earlier one, so that lookups find
+// the same entry as the reverse scan below.  Interned keys are unique
+// strings, so they are compared by address.  Keys that aren't
+// interned are left out; find() scans for them.
+void Dict::hashAdd(int idx) {
+  char *key;
+  int keyAtom;
+  Guint h;
+
+  key = entries[idx].key;
+  if ((keyAtom = NameTable::getAtom(key)) < 0) {
+    return;
+  }
+  h = hashKey(keyAtom) & (hashSize - 1);
+  while (hashTab[h] >= 0 && entries[hashTab[h]].key != key) {
+    h = (h + 1) & (hashSize - 1);
+  }
+  hashTab[h] = idx;
+}
+
+void Dict::buildHash() {
   int i;
 
+  gfree(hashTab);
+  for (hashSize = 64; hashSize < 2 * size; hashSize *= 2) ;
+  hashTab = (int *)gmallocn(hashSize, sizeof(int));
+  for (i = 0; i < hashSize; ++i) {
+    hashTab[i] = -1;
+  }
+  for (i = 0; i < length; ++i) {
+    hashAdd(i);
+  }
+}
+
+DictEntry *Dict::find(char *key) {
+  char *name;
+  Guint h;
+  int keyAtom, i;
+
+  // a key that isn't interned can only be in a dict once the name
+  // table is full
+  if ((keyAtom = NameTable::find(key)) < 0) {
+    if (NameTable::isFull()) {
+      for (i = length - 1; i >= 0; --i) {
+	if (NameTable::getAtom(entries[i].key) < 0 &&
+	    !strcmp(entries[i].key, key)) {
+	  return &entries[i];
+	}
+      }
+    }
+    return NULL;
+  }
+
+  name = NameTable::getName(keyAtom);
+  if (hashTab) {
+    h = hashKey(keyAtom) & (hashSize - 1);
+    while ((i = hashTab[h]) >= 0) {
+      if (entries[i].key == name) {
+	return &entries[i];
+      }
+      h = (h + 1) & (hashSize - 1);
+    }
+    return NULL;
+  }
   for (i = length - 1; i >=0; --i) {
-    if (!strcmp(key, entries[i].key))
+    if (entries[i].key == name)
       return &entries[i];
   }
   return NULL;
 }
 
 void Dict::remove(char *key) {
-  int i; 
-  bool found = false;
-  DictEntry tmp;
-  if(length == 0) return;
-
-  for(i=0; i<length; i++) {
-    if (!strcmp(key, entries[i].key)) {
-      found = true;
-      break;
-    }
-  }
-  if(!found) return;
+  DictEntry *e;
+  int i;
+
+  if (!(e = find(key))) return;
+  i = (int)(e - entries);
+  NameTable::freeName(entries[i].key);
   //replace the deleted entry with the last entry
   length -= 1;
-  tmp = entries[length];
   if (i!=length) //don't copy the last entry if it is deleted 
-    entries[i] = tmp;
+    entries[i] = entries[length];
+  // the moved entry changes index, so rebuild the hash index
+  if (hashTab) {
+    gfree(hashTab);
+    hashTab = NULL;
+    hashSize = 0;
+    if (length > dictHashThreshold) {
+      buildHash();
+    }
+  }
 }
 
 void Dict::set(char *key, Object *val) {
@@ -31,12 +31,15 @@
 
 #include "Object.h"
 
+// Dicts with more entries than this get a hash index for lookups.
+#define dictHashThreshold 16
+
 //------------------------------------------------------------------------
 // Dict
 //------------------------------------------------------------------------
 
 struct DictEntry {
-  char *key;
+  char *key;			// a name string (see NameTable)
   Object val;
 };
 
@@ -57,8 +60,13 @@ public:
   // Get number of entries.
   int getLength() { return length; }
 
-  // Add an entry.  NB: does not copy key.
+  // Add an entry.  NB: takes ownership of key, which is freed once
+  // it has been interned.
   void add(char *key, Object *val);
+  // Add an entry whose key is a name string returned by
+  // NameTable::intern() or NameTable::copyName(), which the dict
+  // takes over.
+  void addName(char *key, Object *val);
 
   // Update the value of an existing entry, otherwise create it
   void set(char *key, Object *val);
@@ -91,8 +99,12 @@ private:
   int size;			// size of <entries> array
   int length;			// number of entries in dictionary
   int ref;			// reference count
+  int *hashTab;			// hash index into <entries>, or NULL
+  int hashSize;			// size of <hashTab> (a power of two)
 
   DictEntry *find(char *key);
+  void hashAdd(int idx);
+  void buildHash();
 };
 
 #endif
@@ -48,15 +48,35 @@ static void defaultErrorFunction(int pos, char *msg, va_list args)
 
 static void (*errorFunction)(int, char *, va_list args) = defaultErrorFunction;
 
+#if MULTITHREADED
+#  ifdef _MSC_VER
+static __declspec(thread) GBool threadErrQuiet = gFalse;
+#  else
+static __thread GBool threadErrQuiet = gFalse;
+#  endif
+#else
+static GBool threadErrQuiet = gFalse;
+#endif
+
 void setErrorFunction(void (* f)(int, char *, va_list args))
 {
     errorFunction = f;
 }
 
+void setThreadErrQuiet(GBool quiet)
+{
+    threadErrQuiet = quiet;
+}
+
+GBool getThreadErrQuiet()
+{
+    return threadErrQuiet;
+}
+
 void CDECL error(int pos, char *msg, ...) {
   va_list args;
   // NB: this can be called before the globalParams object is created
-  if (globalParams && globalParams->getErrQuiet()) {
+  if (threadErrQuiet || (globalParams && globalParams->getErrQuiet())) {
     return;
   }
   va_start(args, msg);
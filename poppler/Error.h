@@ -31,10 +31,16 @@
 
 #include <stdarg.h>
 #include "poppler-config.h"
+#include "goo/gtypes.h"
 
 extern void CDECL error(int pos, char *msg, ...) GCC_PRINTF_FORMAT (2, 3);
 void warning(char *msg, ...) GCC_PRINTF_FORMAT (1, 2);
 
 void setErrorFunction(void (* f)(int , char *, va_list args));
 
+// Suppress the error messages of the calling thread only, unlike
+// GlobalParams::setErrQuiet.
+void setThreadErrQuiet(GBool quiet);
+GBool getThreadErrQuiet();
+
 #endif
@@ -17,6 +17,7 @@ FlateStream::FlateStream(Stream *strA, int predictor, int columns, int colors, i
     pred = NULL;
   }
   out_pos = 0;
+  in_span = gFalse;
   memset(&d_stream, 0, sizeof(d_stream));
   inflateInit(&d_stream);
 }
@@ -38,6 +39,7 @@ void FlateStream::reset() {
 
   str->reset();
   d_stream.avail_in = 0;
+  in_span = gFalse;
   status = Z_OK;
   out_pos = 0;
   out_buf_len = 0;
@@ -67,6 +69,42 @@ int FlateStream::lookChar() {
   return out_buf[out_pos];
 }
 
+int FlateStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  if (pred) {
+    return pred->getChars(nChars, buffer);
+  }
+  for (n = 0; n < nChars && !fill_buffer(); n += m) {
+    m = out_buf_len - out_pos;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, out_buf + out_pos, m);
+    out_pos += m;
+  }
+  return n;
+}
+
+int FlateStream::lookSpan(Guchar **span) {
+  if (pred) {
+    return pred->lookSpan(span);
+  }
+  if (fill_buffer()) {
+    return 0;
+  }
+  *span = out_buf + out_pos;
+  return out_buf_len - out_pos;
+}
+
+void FlateStream::skipSpan(int n) {
+  if (pred) {
+    pred->skipSpan(n);
+  } else {
+    out_pos += n;
+  }
+}
+
 int FlateStream::fill_buffer() {
   /* only fill the buffer if it has all been used */
   if (out_pos >= out_buf_len) {
@@ -83,18 +121,35 @@ int FlateStream::fill_buffer() {
     while (1) {
       /* buffer is empty so we need to fill it */
       if (d_stream.avail_in == 0) {
-	int c;
-	/* read from the source stream */
-	while (d_stream.avail_in < sizeof(in_buf) && (c = str->getChar()) != EOF) {
-	  in_buf[d_stream.avail_in++] = c;
+	int c, n;
+	Guchar *span;
+	/* inflate straight from the source stream's data when it can show
+	   it to us, and only take what inflate used, so that nothing past
+	   the end of the compressed data is consumed */
+	if ((n = str->lookSpan(&span)) >= 0) {
+	  d_stream.next_in = span;
+	  d_stream.avail_in = n;
+	  in_span = gTrue;
+	} else {
+	  /* read from the source stream */
+	  while (d_stream.avail_in < sizeof(in_buf) && (c = str->getChar()) != EOF) {
+	    in_buf[d_stream.avail_in++] = c;
+	  }
+	  d_stream.next_in = in_buf;
+	  in_span = gFalse;
 	}
-	d_stream.next_in = in_buf;
       }
 
       /* keep decompressing until we can't anymore */
       if (d_stream.avail_out == 0 || d_stream.avail_in == 0 || (status != Z_OK && status != Z_BUF_ERROR))
 	break;
-      status = inflate(&d_stream, Z_SYNC_FLUSH);
+      if (in_span) {
+	unsigned int avail = d_stream.avail_in;
+	status = inflate(&d_stream, Z_SYNC_FLUSH);
+	str->skipSpan(avail - d_stream.avail_in);
+      } else {
+	status = inflate(&d_stream, Z_SYNC_FLUSH);
+      }
     }
 
     out_buf_len = sizeof(out_buf) - d_stream.avail_out;
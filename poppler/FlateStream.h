@@ -51,6 +51,9 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int lookSpan(Guchar **span);
+  virtual void skipSpan(int n);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -61,6 +64,8 @@ private:
   int status;
   /* in_buf currently needs to be 1 or we over read from EmbedStreams */
   unsigned char in_buf[1];
+  /* set when next_in points into a span of str rather than in_buf */
+  GBool in_span;
   unsigned char out_buf[4096];
   int out_pos;
   int out_buf_len;
@@ -295,6 +295,11 @@ Operator Gfx::opTab[] = {
 
 #define numOps (sizeof(opTab) / sizeof(Operator))
 
+// The operators are keywords of the name table, so their atoms are
+// small.  This runs while the library is loaded.
+Operator **Gfx::opAtomTab = NULL;
+int Gfx::opAtomTabSize = initOpAtomTab();
+
 static inline GBool isSameGfxColor(const GfxColor &colorA, const GfxColor &colorB, Guint nComps, double delta) {
   for (Guint k = 0; k < nComps; ++k) {
     if (abs(colorA.c[k] - colorB.c[k]) > delta) {
@@ -800,7 +805,7 @@ void Gfx::execOp(Object *cmd, Object args[], int numArgs) {
 
   // find operator
   name = cmd->getCmd();
-  if (!(op = findOp(name))) {
+  if (!(op = findOp(cmd->getCmdAtom()))) {
     if (ignoreUndef == 0)
       error(getPos(), "Unknown operator '%s'", name);
     return;
@@ -840,25 +845,27 @@ void Gfx::execOp(Object *cmd, Object args[], int numArgs) {
   (this->*op->func)(argPtr, numArgs);
 }
 
-Operator *Gfx::findOp(char *name) {
-  int a, b, m, cmp;
-
-  a = -1;
-  b = numOps;
-  // invariant: opTab[a] < name < opTab[b]
-  while (b - a > 1) {
-    m = (a + b) / 2;
-    cmp = strcmp(opTab[m].name, name);
-    if (cmp < 0)
-      a = m;
-    else if (cmp > 0)
-      b = m;
-    else
-      a = b = m;
+int Gfx::initOpAtomTab() {
+  int atoms[numOps];
+  int size, i;
+
+  size = 0;
+  for (i = 0; i < (int)numOps; ++i) {
+    atoms[i] = NameTable::find(opTab[i].name);
+    if (atoms[i] >= size) {
+      size = atoms[i] + 1;
+    }
   }
-  if (cmp != 0)
-    return NULL;
-  return &opTab[a];
+  opAtomTab = (Operator **)gmallocn(size, sizeof(Operator *));
+  for (i = 0; i < size; ++i) {
+    opAtomTab[i] = NULL;
+  }
+  for (i = 0; i < (int)numOps; ++i) {
+    if (atoms[i] >= 0) {
+      opAtomTab[atoms[i]] = &opTab[i];
+    }
+  }
+  return size;
 }
 
 GBool Gfx::checkArg(Object *arg, TchkType type) {
@@ -4433,14 +4440,14 @@ Stream *Gfx::buildImageStream() {
       error(getPos(), "Inline image dictionary key must be a name object");
       obj.free();
     } else {
-      key = copyString(obj.getName());
+      key = NameTable::copyName(obj.getName());
       obj.free();
       parser->getObj(&obj);
       if (obj.isEOF() || obj.isError()) {
-	gfree(key);
+	NameTable::freeName(key);
 	break;
       }
-      dict.dictAdd(key, &obj);
+      dict.getDict()->addName(key, &obj);
     }
     parser->getObj(&obj);
   }
@@ -224,10 +224,16 @@ private:
   void *abortCheckCbkData;
 
   static Operator opTab[];	// table of operators
+  static Operator **opAtomTab;	// operators indexed by the atoms of
+				//   their names
+  static int opAtomTabSize;	// size of <opAtomTab>
 
+  static int initOpAtomTab();
   void go(GBool topLevel);
   void execOp(Object *cmd, Object args[], int numArgs);
-  Operator *findOp(char *name);
+  Operator *findOp(int atom)
+    { return atom >= 0 && atom < opAtomTabSize ? opAtomTab[atom]
+	                                          : (Operator *)NULL; }
   GBool checkArg(Object *arg, TchkType type);
   int getPos();
 
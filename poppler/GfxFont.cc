@@ -487,7 +487,7 @@ char *GfxFont::readEmbFontFile(XRef *xref, int *len) {
   char *buf;
   Object obj1, obj2;
   Stream *str;
-  int c;
+  int n;
   int size, i;
 
   obj1.initRef(embFontID.num, embFontID.gen);
@@ -505,13 +505,14 @@ char *GfxFont::readEmbFontFile(XRef *xref, int *len) {
   buf = NULL;
   i = size = 0;
   str->reset();
-  while ((c = str->getChar()) != EOF) {
+  do {
     if (i == size) {
       size += 4096;
       buf = (char *)grealloc(buf, size);
     }
-    buf[i++] = c;
-  }
+    n = str->getChars(size - i, (Guchar *)buf + i);
+    i += n;
+  } while (n > 0);
   *len = i;
   str->close();
 
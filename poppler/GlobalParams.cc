@@ -687,6 +687,16 @@ GlobalParams::GlobalParams(const char *customPopplerDataDir)
   printCommands = gFalse;
   profileCommands = gFalse;
   errQuiet = gFalse;
+  httpMaxConnections = 4;
+  httpMultiRange = gTrue;
+  httpHostTimings = new GooHash(gTrue);
+  httpCacheDir = NULL;
+  httpCacheSize = 64 * 1024 * 1024;
+  httpMemoryCacheSize = 32 * 1024 * 1024;
+  httpChunkSize = 8192;
+  httpAdaptiveChunks = gTrue;
+  objectCacheSize = 1024;
+  objectStreamCacheSize = 4 * 1024 * 1024;
 
   cidToUnicodeCache = new CharCodeToUnicodeCache(cidToUnicodeCacheSize);
   unicodeToUnicodeCache =
@@ -867,6 +877,10 @@ GlobalParams::~GlobalParams() {
   deleteGooList(psFonts16, PSFontParam);
   delete textEncoding;
   deleteGooList(fontDirs, GooString);
+  deleteGooHash(httpHostTimings, HttpHostTiming);
+  if (httpCacheDir) {
+    delete httpCacheDir;
+  }
 
   GooHashIter *iter;
   GooString *key;
@@ -1568,6 +1582,98 @@ GBool GlobalParams::getErrQuiet() {
   return errQuiet;
 }
 
+int GlobalParams::getHttpMaxConnections() {
+  int n;
+
+  lockGlobalParams;
+  n = httpMaxConnections;
+  unlockGlobalParams;
+  return n;
+}
+
+GBool GlobalParams::getHttpMultiRange() {
+  GBool multiRange;
+
+  lockGlobalParams;
+  multiRange = httpMultiRange;
+  unlockGlobalParams;
+  return multiRange;
+}
+
+GBool GlobalParams::getHttpHostTiming(GooString *host, HttpHostTiming *timing) {
+  HttpHostTiming *t;
+
+  lockGlobalParams;
+  if ((t = (HttpHostTiming *)httpHostTimings->lookup(host))) {
+    *timing = *t;
+  }
+  unlockGlobalParams;
+  return t != NULL;
+}
+
+GooString *GlobalParams::getHttpCacheDir() {
+  GooString *s;
+
+  lockGlobalParams;
+  s = httpCacheDir ? httpCacheDir->copy() : (GooString *)NULL;
+  unlockGlobalParams;
+  return s;
+}
+
+Guint GlobalParams::getHttpCacheSize() {
+  Guint size;
+
+  lockGlobalParams;
+  size = httpCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+Guint GlobalParams::getHttpMemoryCacheSize() {
+  Guint size;
+
+  lockGlobalParams;
+  size = httpMemoryCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+int GlobalParams::getHttpChunkSize() {
+  int size;
+
+  lockGlobalParams;
+  size = httpChunkSize;
+  unlockGlobalParams;
+  return size;
+}
+
+GBool GlobalParams::getHttpAdaptiveChunks() {
+  GBool adaptive;
+
+  lockGlobalParams;
+  adaptive = httpAdaptiveChunks;
+  unlockGlobalParams;
+  return adaptive;
+}
+
+int GlobalParams::getObjectCacheSize() {
+  int size;
+
+  lockGlobalParams;
+  size = objectCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+Guint GlobalParams::getObjectStreamCacheSize() {
+  Guint size;
+
+  lockGlobalParams;
+  size = objectStreamCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
 CharCodeToUnicode *GlobalParams::getCIDToUnicode(GooString *collection) {
   GooString *fileName;
   CharCodeToUnicode *ctu;
@@ -1874,6 +1980,75 @@ void GlobalParams::setErrQuiet(GBool errQuietA) {
   unlockGlobalParams;
 }
 
+void GlobalParams::setHttpMaxConnections(int maxConnections) {
+  lockGlobalParams;
+  httpMaxConnections = maxConnections;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setHttpMultiRange(GBool multiRange) {
+  lockGlobalParams;
+  httpMultiRange = multiRange;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setHttpHostTiming(GooString *host, HttpHostTiming *timing) {
+  HttpHostTiming *t;
+
+  lockGlobalParams;
+  if (!(t = (HttpHostTiming *)httpHostTimings->lookup(host))) {
+    t = new HttpHostTiming;
+    httpHostTimings->add(host->copy(), t);
+  }
+  *t = *timing;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setHttpCacheDir(char *dir) {
+  lockGlobalParams;
+  if (httpCacheDir) {
+    delete httpCacheDir;
+  }
+  httpCacheDir = dir ? new GooString(dir) : (GooString *)NULL;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setHttpCacheSize(Guint size) {
+  lockGlobalParams;
+  httpCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setHttpMemoryCacheSize(Guint size) {
+  lockGlobalParams;
+  httpMemoryCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setHttpChunkSize(int size) {
+  lockGlobalParams;
+  httpChunkSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setHttpAdaptiveChunks(GBool adaptive) {
+  lockGlobalParams;
+  httpAdaptiveChunks = adaptive;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setObjectCacheSize(int size) {
+  lockGlobalParams;
+  objectCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setObjectStreamCacheSize(Guint size) {
+  lockGlobalParams;
+  objectStreamCacheSize = size;
+  unlockGlobalParams;
+}
+
 void GlobalParams::addSecurityHandler(XpdfSecurityHandler *handler) {
 #ifdef ENABLE_PLUGINS
   lockGlobalParams;
@@ -131,6 +131,15 @@ public:
 
 //------------------------------------------------------------------------
 
+// Network timing measured for one HTTP host, shared by all documents
+// loaded from it.
+struct HttpHostTiming {
+  double rtt;			// request round trip time in seconds
+  double throughput;		// transfer rate in bytes per second
+};
+
+//------------------------------------------------------------------------
+
 enum PSLevel {
   psLevel1,
   psLevel1Sep,
@@ -219,6 +228,16 @@ public:
   GBool getPrintCommands();
   GBool getProfileCommands();
   GBool getErrQuiet();
+  int getHttpMaxConnections();
+  GBool getHttpMultiRange();
+  GBool getHttpHostTiming(GooString *host, HttpHostTiming *timing);
+  GooString *getHttpCacheDir();
+  Guint getHttpCacheSize();
+  Guint getHttpMemoryCacheSize();
+  int getHttpChunkSize();
+  GBool getHttpAdaptiveChunks();
+  int getObjectCacheSize();
+  Guint getObjectStreamCacheSize();
 
   CharCodeToUnicode *getCIDToUnicode(GooString *collection);
   CharCodeToUnicode *getUnicodeToUnicode(GooString *fontName);
@@ -263,6 +282,16 @@ public:
   void setPrintCommands(GBool printCommandsA);
   void setProfileCommands(GBool profileCommandsA);
   void setErrQuiet(GBool errQuietA);
+  void setHttpMaxConnections(int maxConnections);
+  void setHttpMultiRange(GBool multiRange);
+  void setHttpHostTiming(GooString *host, HttpHostTiming *timing);
+  void setHttpCacheDir(char *dir);
+  void setHttpCacheSize(Guint size);
+  void setHttpMemoryCacheSize(Guint size);
+  void setHttpChunkSize(int size);
+  void setHttpAdaptiveChunks(GBool adaptive);
+  void setObjectCacheSize(int size);
+  void setObjectStreamCacheSize(Guint size);
 
   //----- security handlers
 
@@ -347,6 +376,22 @@ private:
   GBool printCommands;		// print the drawing commands
   GBool profileCommands;	// profile the drawing commands
   GBool errQuiet;		// suppress error messages?
+  int httpMaxConnections;	// parallel requests per remote document
+  GBool httpMultiRange;		// coalesce gaps into multi-range requests?
+  GooHash *httpHostTimings;	// measured network timing, indexed by
+				//   host [HttpHostTiming]
+  GooString *httpCacheDir;	// directory for the persistent chunk
+				//   cache, NULL if disabled
+  Guint httpCacheSize;		// size limit of the persistent cache
+  Guint httpMemoryCacheSize;	// memory limit for the downloaded data
+				//   of each remote document, 0 = none
+  int httpChunkSize;		// granularity of remote document caches
+  GBool httpAdaptiveChunks;	// grow requests to the bandwidth-delay
+				//   product?
+  int objectCacheSize;		// parsed objects kept by each xref,
+				//   0 = none
+  Guint objectStreamCacheSize;	// memory for the decoded object streams
+				//   of each xref
 
   CharCodeToUnicodeCache *cidToUnicodeCache;
   CharCodeToUnicodeCache *unicodeToUnicodeCache;
@@ -0,0 +1,500 @@
+//========================================================================
+//
+// Hints.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stdlib.h>
+#include <limits.h>
+#include "goo/gmem.h"
+#include "Object.h"
+#include "Stream.h"
+#include "XRef.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Linearization.h"
+#include "Error.h"
+#include "Hints.h"
+
+//------------------------------------------------------------------------
+// HintsBitReader
+//------------------------------------------------------------------------
+
+// Reads the big-endian bit fields of a hint table.
+class HintsBitReader {
+public:
+
+  HintsBitReader(Stream *strA)
+    { str = strA; buf = 0; bufBits = 0; nBytes = 0; eof = gFalse; }
+
+  // Read an <n>-bit number, 0 <= n <= 32.
+  Guint readBits(int n);
+
+  // Skip to the next byte boundary.
+  void align() { bufBits = 0; }
+
+  void skipBytes(int n) { while (n-- > 0) readBits(8); }
+
+  // Number of bits read so far.
+  double getBitPos() { return nBytes * 8.0 - bufBits; }
+
+  GBool atEOF() { return eof; }
+
+private:
+
+  Stream *str;
+  int buf;
+  int bufBits;
+  int nBytes;			// bytes read from str
+  GBool eof;
+};
+
+Guint HintsBitReader::readBits(int n) {
+  Guint x;
+  int c;
+
+  x = 0;
+  while (n > 0) {
+    if (bufBits == 0) {
+      if ((c = str->getChar()) == EOF) {
+	eof = gTrue;
+	return 0;
+      }
+      buf = c;
+      bufBits = 8;
+      ++nBytes;
+    }
+    x = (x << 1) | ((buf >> --bufBits) & 1);
+    --n;
+  }
+  return x;
+}
+
+//------------------------------------------------------------------------
+
+// Hint tables with more entries than this are treated as damaged.
+#define hintsMaxEntries 1000000
+
+static int cmpRanges(const void *p1, const void *p2) {
+  const Guint *r1 = (const Guint *)p1;
+  const Guint *r2 = (const Guint *)p2;
+
+  if (r1[0] < r2[0]) {
+    return -1;
+  }
+  return r1[0] > r2[0] ? 1 : 0;
+}
+
+//------------------------------------------------------------------------
+// Hints
+//------------------------------------------------------------------------
+
+Hints::Hints(BaseStream *strA, Linearization *linearizationA, XRef *xrefA) {
+  str = strA;
+  linearization = linearizationA;
+  xref = xrefA;
+  read = gFalse;
+  ok = gFalse;
+
+  nPages = 0;
+  pageOffset = NULL;
+  pageLength = NULL;
+  pageObjectNum = NULL;
+  nSharedRefs = NULL;
+  sharedRefs = NULL;
+  pagePreloaded = NULL;
+
+  nGroups = 0;
+  nGroupsFirst = 0;
+  groupOffset = NULL;
+  groupLength = NULL;
+}
+
+Hints::~Hints() {
+  freeTables();
+}
+
+void Hints::freeTables() {
+  int i;
+
+  if (sharedRefs) {
+    for (i = 0; i < nPages; ++i) {
+      gfree(sharedRefs[i]);
+    }
+  }
+  gfree(pageOffset);
+  gfree(pageLength);
+  gfree(pageObjectNum);
+  gfree(nSharedRefs);
+  gfree(sharedRefs);
+  gfree(pagePreloaded);
+  gfree(groupOffset);
+  gfree(groupLength);
+  nPages = 0;
+  pageOffset = NULL;
+  pageLength = NULL;
+  pageObjectNum = NULL;
+  nSharedRefs = NULL;
+  sharedRefs = NULL;
+  pagePreloaded = NULL;
+  nGroups = 0;
+  nGroupsFirst = 0;
+  groupOffset = NULL;
+  groupLength = NULL;
+}
+
+GBool Hints::isOk() {
+  if (!read) {
+    readTables();
+  }
+  return ok;
+}
+
+void Hints::readTables() {
+  Parser *parser;
+  Object obj1, obj2, obj3, obj4, obj;
+  HintsBitReader *reader;
+  Stream *hintStr;
+  int sharedOffset, misses, i, j;
+
+  read = gTrue;
+  misses = str->getMisses();
+
+  // the entries are only meaningful if page 1 is the first page, and
+  // an encrypted hint stream can't be decoded here
+  if (!linearization->isOk() || linearization->getPageFirst() != 0 ||
+      linearization->getNumPages() > hintsMaxEntries ||
+      xref->isEncrypted()) {
+    return;
+  }
+  nPages = linearization->getNumPages();
+
+  obj1.initNull();
+  parser = new Parser(xref,
+	     new Lexer(xref,
+	       str->makeSubStream(str->getStart() +
+				  linearization->getHintsOffset(),
+				  gFalse, 0, &obj1)),
+	     gTrue);
+  parser->getObj(&obj1);
+  parser->getObj(&obj2);
+  parser->getObj(&obj3);
+  parser->getObj(&obj4);
+  if (obj1.isInt() && obj2.isInt() && obj3.isCmd("obj") &&
+      obj4.isStream()) {
+    hintStr = obj4.getStream();
+    hintStr->getDict()->lookup("S", &obj);
+    sharedOffset = obj.isInt() ? obj.getInt() : -1;
+    obj.free();
+
+    if (sharedOffset > 0) {
+      // the shared object table starts at a known offset; it is read
+      // first so that the page entries can be checked against it
+      hintStr->reset();
+      reader = new HintsBitReader(hintStr);
+      reader->skipBytes(sharedOffset);
+      ok = readSharedObjectTable(reader);
+      delete reader;
+      if (ok) {
+	// the page offset table fills the stream up to the shared one
+	hintStr->reset();
+	reader = new HintsBitReader(hintStr);
+	ok = readPageOffsetTable(reader, sharedOffset);
+	delete reader;
+      }
+      hintStr->close();
+    }
+  }
+  obj4.free();
+  obj3.free();
+  obj2.free();
+  obj1.free();
+  delete parser;
+
+  if (ok) {
+    for (i = 0; i < nPages && ok; ++i) {
+      for (j = 0; j < nSharedRefs[i]; ++j) {
+	if (sharedRefs[i][j] < 0 || sharedRefs[i][j] >= nGroups) {
+	  ok = gFalse;
+	  break;
+	}
+      }
+    }
+  }
+  // tables cut short by data that hasn't arrived yet are read again
+  // on the next call
+  if (!ok && str->getMisses() != misses) {
+    freeTables();
+    read = gFalse;
+    return;
+  }
+  if (!ok) {
+    error(-1, "Couldn't read the linearization hint tables");
+  }
+}
+
+GBool Hints::readPageOffsetTable(HintsBitReader *reader, int length) {
+  Guint nObjectsLeast, pageOffsetFirst, pageLengthLeast;
+  Guint *nObjects;
+  int nBitsObjects, nBitsPageLength, nBitsContentOffset;
+  int nBitsContentLength, nBitsNumShared, nBitsShared, nBitsNumerator;
+  double nRefs;
+  int i, j;
+
+  // header, Table F.3
+  nObjectsLeast = reader->readBits(32);
+  pageOffsetFirst = reader->readBits(32);
+  nBitsObjects = reader->readBits(16);
+  pageLengthLeast = reader->readBits(32);
+  nBitsPageLength = reader->readBits(16);
+  reader->readBits(32);		// least content stream offset
+  nBitsContentOffset = reader->readBits(16);
+  reader->readBits(32);		// least content stream length
+  nBitsContentLength = reader->readBits(16);
+  nBitsNumShared = reader->readBits(16);
+  nBitsShared = reader->readBits(16);
+  nBitsNumerator = reader->readBits(16);
+  reader->readBits(16);		// denominator
+  if (reader->atEOF() ||
+      nBitsObjects > 32 || nBitsPageLength > 32 ||
+      nBitsContentOffset > 32 || nBitsContentLength > 32 ||
+      nBitsNumShared > 32 || nBitsShared > 32 || nBitsNumerator > 32) {
+    return gFalse;
+  }
+
+  pageOffset = (Guint *)gmallocn(nPages, sizeof(Guint));
+  pageLength = (Guint *)gmallocn(nPages, sizeof(Guint));
+  pageObjectNum = (int *)gmallocn(nPages, sizeof(int));
+  nSharedRefs = (int *)gmallocn(nPages, sizeof(int));
+  sharedRefs = (int **)gmallocn(nPages, sizeof(int *));
+  pagePreloaded = (GBool *)gmallocn(nPages, sizeof(GBool));
+  for (i = 0; i < nPages; ++i) {
+    nSharedRefs[i] = 0;
+    sharedRefs[i] = NULL;
+    pagePreloaded[i] = gFalse;
+  }
+
+  // per-page entries, Table F.4; Acrobat starts every item on a byte
+  // boundary
+  nObjects = (Guint *)gmallocn(nPages, sizeof(Guint));
+  for (i = 0; i < nPages; ++i) {
+    nObjects[i] = nObjectsLeast + reader->readBits(nBitsObjects);
+  }
+  reader->align();
+  for (i = 0; i < nPages; ++i) {
+    pageLength[i] = pageLengthLeast + reader->readBits(nBitsPageLength);
+  }
+  reader->align();
+  nRefs = 0;
+  for (i = 0; i < nPages; ++i) {
+    nSharedRefs[i] = (int)reader->readBits(nBitsNumShared);
+    if (nSharedRefs[i] < 0 || nSharedRefs[i] > nGroups) {
+      gfree(nObjects);
+      nSharedRefs[i] = 0;
+      return gFalse;
+    }
+    nRefs += nSharedRefs[i];
+  }
+  reader->align();
+
+  // the shared object identifiers and numerators must fit into what is
+  // left of the table -- don't let a short hint stream declare huge
+  // arrays
+  if (nRefs > hintsMaxEntries ||
+      nRefs * (nBitsShared + nBitsNumerator) >
+        length * 8.0 - reader->getBitPos()) {
+    gfree(nObjects);
+    for (i = 0; i < nPages; ++i) {
+      nSharedRefs[i] = 0;
+    }
+    return gFalse;
+  }
+  for (i = 0; i < nPages; ++i) {
+    sharedRefs[i] = (int *)gmallocn(nSharedRefs[i], sizeof(int));
+    for (j = 0; j < nSharedRefs[i]; ++j) {
+      sharedRefs[i][j] = (int)reader->readBits(nBitsShared);
+    }
+  }
+  reader->align();
+  for (i = 0; i < nPages; ++i) {
+    for (j = 0; j < nSharedRefs[i]; ++j) {
+      reader->readBits(nBitsNumerator);
+    }
+  }
+  reader->align();
+  // the content stream items are not needed
+
+  // the objects of pages 2..n are numbered from 1 on, in page order
+  pageObjectNum[0] = linearization->getObjectNumberFirst();
+  for (i = 1; i < nPages; ++i) {
+    pageObjectNum[i] = (i == 1 ? 1 : pageObjectNum[i-1] + nObjects[i-1]);
+    if (pageObjectNum[i] <= 0) {
+      gfree(nObjects);
+      return gFalse;
+    }
+  }
+  gfree(nObjects);
+
+  pageOffset[0] = pageOffsetFirst;
+  for (i = 1; i < nPages; ++i) {
+    pageOffset[i] = pageOffset[i-1] + pageLength[i-1];
+  }
+  for (i = 0; i < nPages; ++i) {
+    pageOffset[i] = adjustOffset(pageOffset[i]);
+  }
+
+  return !reader->atEOF();
+}
+
+GBool Hints::readSharedObjectTable(HintsBitReader *reader) {
+  Guint groupOffsetFirst, groupLengthLeast;
+  int nBitsObjects, nBitsLength;
+  int i;
+
+  // header, Table F.5
+  reader->readBits(32);		// object number of the first shared object
+  groupOffsetFirst = reader->readBits(32);
+  nGroupsFirst = (int)reader->readBits(32);
+  nGroups = (int)reader->readBits(32);
+  nBitsObjects = reader->readBits(16);
+  groupLengthLeast = reader->readBits(32);
+  nBitsLength = reader->readBits(16);
+  if (reader->atEOF() || nGroups < 0 || nGroups > hintsMaxEntries ||
+      nGroupsFirst < 0 || nGroupsFirst > nGroups ||
+      nBitsObjects > 32 || nBitsLength > 32) {
+    nGroups = nGroupsFirst = 0;
+    return gFalse;
+  }
+
+  // per-group entries, Table F.6; only the lengths are needed
+  groupOffset = (Guint *)gmallocn(nGroups, sizeof(Guint));
+  groupLength = (Guint *)gmallocn(nGroups, sizeof(Guint));
+  for (i = 0; i < nGroups; ++i) {
+    groupLength[i] = groupLengthLeast + reader->readBits(nBitsLength);
+  }
+
+  // groups in the first-page section are loaded with the first page
+  for (i = 0; i < nGroups; ++i) {
+    if (i < nGroupsFirst) {
+      groupOffset[i] = 0;
+    } else if (i == nGroupsFirst) {
+      groupOffset[i] = groupOffsetFirst;
+    } else {
+      groupOffset[i] = groupOffset[i-1] + groupLength[i-1];
+    }
+  }
+  for (i = nGroupsFirst; i < nGroups; ++i) {
+    groupOffset[i] = adjustOffset(groupOffset[i]);
+  }
+
+  return !reader->atEOF();
+}
+
+// Offsets in the hint tables are given as if the hint streams were
+// not in the file.
+Guint Hints::adjustOffset(Guint offset) {
+  Guint adjusted;
+
+  adjusted = offset;
+  if (offset >= linearization->getHintsOffset()) {
+    adjusted += linearization->getHintsLength();
+  }
+  if (linearization->getHintsLength2() &&
+      offset >= linearization->getHintsOffset2()) {
+    adjusted += linearization->getHintsLength2();
+  }
+  return adjusted;
+}
+
+int Hints::getPageObjectNum(int page) {
+  if (!isOk() || page < 1 || page > nPages) {
+    return 0;
+  }
+  return pageObjectNum[page - 1];
+}
+
+int Hints::getPageRanges(int page, Guint **from, Guint **to) {
+  Guint *ranges;
+  Guint start, end;
+  int n, nMerged, i, g;
+
+  *from = *to = NULL;
+  if (!isOk() || page < 1 || page > nPages) {
+    return 0;
+  }
+
+  // everything the first page needs is in front of /E
+  if (page == 1) {
+    *from = (Guint *)gmalloc(sizeof(Guint));
+    *to = (Guint *)gmalloc(sizeof(Guint));
+    (*from)[0] = 0;
+    (*to)[0] = linearization->getEndFirstPage();
+    return 1;
+  }
+
+  ranges = (Guint *)gmallocn(2 * (1 + nSharedRefs[page - 1]), sizeof(Guint));
+  n = 0;
+  ranges[2*n] = pageOffset[page - 1];
+  ranges[2*n+1] = pageOffset[page - 1] + pageLength[page - 1];
+  ++n;
+  for (i = 0; i < nSharedRefs[page - 1]; ++i) {
+    g = sharedRefs[page - 1][i];
+    if (g >= nGroupsFirst) {
+      ranges[2*n] = groupOffset[g];
+      ranges[2*n+1] = groupOffset[g] + groupLength[g];
+      ++n;
+    }
+  }
+  qsort(ranges, n, 2 * sizeof(Guint), &cmpRanges);
+
+  *from = (Guint *)gmallocn(n, sizeof(Guint));
+  *to = (Guint *)gmallocn(n, sizeof(Guint));
+  nMerged = 0;
+  for (i = 0; i < n; ++i) {
+    start = ranges[2*i];
+    end = ranges[2*i+1];
+    if (nMerged > 0 && start <= (*to)[nMerged - 1]) {
+      if (end > (*to)[nMerged - 1]) {
+	(*to)[nMerged - 1] = end;
+      }
+    } else {
+      (*from)[nMerged] = start;
+      (*to)[nMerged] = end;
+      ++nMerged;
+    }
+  }
+  gfree(ranges);
+  return nMerged;
+}
+
+GBool Hints::preloadPage(int page) {
+  Guint *from, *to;
+  int n, i;
+
+  if (!isOk() || page < 1 || page > nPages) {
+    return gFalse;
+  }
+  if (pagePreloaded[page - 1]) {
+    return gTrue;
+  }
+  pagePreloaded[page - 1] = gTrue;
+  n = getPageRanges(page, &from, &to);
+  for (i = 0; i < n; ++i) {
+    from[i] += str->getStart();
+    to[i] += str->getStart();
+  }
+  if (n > 0) {
+    str->preload(n, from, to);
+  }
+  gfree(from);
+  gfree(to);
+  return gTrue;
+}
@@ -0,0 +1,83 @@
+//========================================================================
+//
+// Hints.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef HINTS_H
+#define HINTS_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "goo/gtypes.h"
+
+class BaseStream;
+class Stream;
+class XRef;
+class Linearization;
+class HintsBitReader;
+
+//------------------------------------------------------------------------
+// Hints
+//
+// Page offset and shared object hint tables of a linearized file, see
+// PDF Reference, Appendix F.  They are read from the primary hint
+// stream the first time they are needed.
+//------------------------------------------------------------------------
+
+class Hints {
+public:
+
+  Hints(BaseStream *strA, Linearization *linearizationA, XRef *xrefA);
+  ~Hints();
+
+  // Could the hint tables be read?
+  GBool isOk();
+
+  // Object number of the page object of <page> (1-based), 0 if
+  // unknown.
+  int getPageObjectNum(int page);
+
+  // Byte ranges holding the objects of <page> and the shared objects
+  // it uses, sorted by offset and merged where they touch.  Returns the
+  // number of ranges; the caller frees <from> and <to> with gfree.
+  int getPageRanges(int page, Guint **from, Guint **to);
+
+  // Preload the ranges of <page> in one go, the first time it is
+  // called for the page.  Returns false if the hint tables don't cover
+  // <page>.
+  GBool preloadPage(int page);
+
+private:
+
+  void readTables();
+  void freeTables();
+  GBool readPageOffsetTable(HintsBitReader *reader, int length);
+  GBool readSharedObjectTable(HintsBitReader *reader);
+  Guint adjustOffset(Guint offset);
+
+  BaseStream *str;
+  Linearization *linearization;
+  XRef *xref;
+  GBool read;			// readTables was called
+  GBool ok;
+
+  int nPages;
+  Guint *pageOffset;		// offset of each page's objects
+  Guint *pageLength;
+  int *pageObjectNum;
+  int *nSharedRefs;		// number of shared groups each page uses
+  int **sharedRefs;		// shared group indices of each page
+  GBool *pagePreloaded;
+
+  int nGroups;
+  int nGroupsFirst;		// groups in the first-page section
+  Guint *groupOffset;		// only for groups >= nGroupsFirst
+  Guint *groupLength;
+};
+
+#endif
@@ -70,6 +70,7 @@ Lexer::Lexer(XRef *xrefA, Stream *str) {
 
   lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
   xref = xrefA;
+  spanStart = spanPtr = spanEnd = NULL;
 
   curStr.initStream(str);
   streams = new Array(xref);
@@ -84,6 +85,7 @@ Lexer::Lexer(XRef *xrefA, Object *obj) {
 
   lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
   xref = xrefA;
+  spanStart = spanPtr = spanEnd = NULL;
 
   if (obj->isStream()) {
     streams = new Array(xref);
@@ -110,8 +112,12 @@ Lexer::~Lexer() {
   }
 }
 
-int Lexer::getChar(GBool comesFromLook) {
-  int c;
+// Called when the current span is used up.  Note that the span isn't
+// handed back to the stream when the lexer is deleted: anyone reading
+// the stream after that starts at the last position the lexer synced.
+int Lexer::getCharSlow(GBool comesFromLook) {
+  Guchar *span;
+  int c, n;
 
   if (LOOK_VALUE_NOT_CACHED != lookCharLastValueCached) {
     c = lookCharLastValueCached;
@@ -119,8 +125,17 @@ int Lexer::getChar(GBool comesFromLook) {
     return c;
   }
 
+  syncSpan();
   c = EOF;
-  while (!curStr.isNone() && (c = curStr.streamGetChar()) == EOF) {
+  while (!curStr.isNone()) {
+    if ((n = curStr.getStream()->lookSpan(&span)) > 0) {
+      spanStart = spanPtr = span;
+      spanEnd = span + n;
+      return *spanPtr++;
+    }
+    if (n < 0 && (c = curStr.streamGetChar()) != EOF) {
+      return c;
+    }
     if (comesFromLook == gTrue) {
       return EOF;
     } else {
@@ -133,20 +148,31 @@ int Lexer::getChar(GBool comesFromLook) {
       }
     }
   }
-  return c;
+  return EOF;
 }
 
-int Lexer::lookChar() {
-  
+int Lexer::lookCharSlow() {
+  int c;
+
   if (LOOK_VALUE_NOT_CACHED != lookCharLastValueCached) {
     return lookCharLastValueCached;
   }
-  lookCharLastValueCached = getChar(gTrue);
-  if (lookCharLastValueCached == EOF) {
-    lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
-    return EOF;
-  } else {
-    return lookCharLastValueCached;
+  c = getCharSlow(gTrue);
+  // a char from a span isn't consumed, just step back over it
+  if (spanPtr) {
+    --spanPtr;
+    return c;
+  }
+  if (c != EOF) {
+    lookCharLastValueCached = c;
+  }
+  return c;
+}
+
+void Lexer::syncSpan() {
+  if (spanStart) {
+    curStr.getStream()->skipSpan((int)(spanPtr - spanStart));
+    spanStart = spanPtr = spanEnd = NULL;
   }
 }
 
@@ -62,18 +62,21 @@ public:
   // Skip over one character.
   void skipChar() { getChar(); }
 
-  // Get stream.
+  // Get stream.  The stream is positioned right after the chars the
+  // lexer has read.
   Stream *getStream()
-    { return curStr.isNone() ? (Stream *)NULL : curStr.getStream(); }
+    { syncSpan();
+      return curStr.isNone() ? (Stream *)NULL : curStr.getStream(); }
 
   // Get current position in file.  This is only used for error
   // messages, so it returns an int instead of a Guint.
   int getPos()
-    { return curStr.isNone() ? -1 : (int)curStr.streamGetPos(); }
+    { syncSpan();
+      return curStr.isNone() ? -1 : (int)curStr.streamGetPos(); }
 
   // Set position in file.
   void setPos(Guint pos, int dir = 0)
-    { if (!curStr.isNone()) curStr.streamSetPos(pos, dir); }
+    { syncSpan(); if (!curStr.isNone()) curStr.streamSetPos(pos, dir); }
 
   // Returns true if <c> is a whitespace character.
   static GBool isSpace(int c);
@@ -90,14 +93,26 @@ public:
 
 private:
 
-  int getChar(GBool comesFromLook = gFalse);
-  int lookChar();
+  // Chars are read straight out of the stream's buffer where the
+  // stream offers one (see Stream::lookSpan), and only consumed from
+  // the stream when the span is used up or someone else needs the
+  // stream.
+  int getChar(GBool comesFromLook = gFalse)
+    { return spanPtr < spanEnd ? *spanPtr++ : getCharSlow(comesFromLook); }
+  int lookChar()
+    { return spanPtr < spanEnd ? *spanPtr : lookCharSlow(); }
+  int getCharSlow(GBool comesFromLook);
+  int lookCharSlow();
+  void syncSpan();
 
   Array *streams;		// array of input streams
   int strPtr;			// index of current stream
   Object curStr;		// current stream
   GBool freeArray;		// should lexer free the streams array?
   char tokBuf[tokBufSize];	// temporary token buffer
+  Guchar *spanStart;		// span of curStr being read, or NULL
+  Guchar *spanPtr;		// next char in the span
+  Guchar *spanEnd;		// end of the span
 
   XRef *xref;
 };
@@ -0,0 +1,180 @@
+//========================================================================
+//
+// Linearization.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include <ctype.h>
+#include "Object.h"
+#include "Stream.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Linearization.h"
+
+//------------------------------------------------------------------------
+
+// The linearization dictionary and the start of the first-page xref
+// section must be within this many bytes of the start of the file.
+#define linearizationSearchSize 2048
+
+static GBool getUint(Dict *dict, const char *key, Guint *val) {
+  Object obj;
+  GBool ok;
+
+  dict->lookup((char *)key, &obj);
+  if ((ok = obj.isInt() && obj.getInt() >= 0)) {
+    *val = (Guint)obj.getInt();
+  }
+  obj.free();
+  return ok;
+}
+
+//------------------------------------------------------------------------
+// Linearization
+//------------------------------------------------------------------------
+
+Linearization::Linearization(BaseStream *str) {
+  Parser *parser;
+  Object obj1, obj2, obj3, linDict, obj, hint;
+  Guint fileLength, n;
+
+  ok = gFalse;
+  length = 0;
+  hintsOffset = hintsLength = 0;
+  hintsOffset2 = hintsLength2 = 0;
+  objectNumberFirst = 0;
+  endFirstPage = 0;
+  numPages = 0;
+  mainXRefEntriesOffset = 0;
+  pageFirst = 0;
+  firstPageXRefPos = 0;
+
+  obj1.initNull();
+  parser = new Parser(NULL,
+	     new Lexer(NULL,
+	       str->makeSubStream(str->getStart(), gFalse, 0, &obj1)),
+	     gFalse);
+  parser->getObj(&obj1);
+  parser->getObj(&obj2);
+  parser->getObj(&obj3);
+  parser->getObj(&linDict);
+  if (!obj1.isInt() || !obj2.isInt() || !obj3.isCmd("obj") ||
+      !linDict.isDict()) {
+    goto done;
+  }
+  linDict.dictLookup("Linearized", &obj);
+  if (!obj.isNum() || obj.getNum() <= 0) {
+    obj.free();
+    goto done;
+  }
+  obj.free();
+
+  if (!getUint(linDict.getDict(), "L", &length) ||
+      !getUint(linDict.getDict(), "E", &endFirstPage) ||
+      !getUint(linDict.getDict(), "T", &mainXRefEntriesOffset)) {
+    goto done;
+  }
+  linDict.dictLookup("O", &obj);
+  objectNumberFirst = obj.isInt() ? obj.getInt() : 0;
+  obj.free();
+  linDict.dictLookup("N", &obj);
+  numPages = obj.isInt() ? obj.getInt() : 0;
+  obj.free();
+  linDict.dictLookup("P", &obj);
+  pageFirst = obj.isInt() ? obj.getInt() : 0;
+  obj.free();
+  if (objectNumberFirst <= 0 || numPages <= 0 ||
+      pageFirst < 0 || pageFirst >= numPages) {
+    goto done;
+  }
+
+  linDict.dictLookup("H", &obj);
+  if (obj.isArray() && (obj.arrayGetLength() == 2 ||
+			obj.arrayGetLength() == 4)) {
+    for (n = 0; n < (Guint)obj.arrayGetLength(); ++n) {
+      if (!obj.arrayGet(n, &hint)->isInt() || hint.getInt() < 0) {
+	hint.free();
+	break;
+      }
+      switch (n) {
+      case 0: hintsOffset = (Guint)hint.getInt(); break;
+      case 1: hintsLength = (Guint)hint.getInt(); break;
+      case 2: hintsOffset2 = (Guint)hint.getInt(); break;
+      case 3: hintsLength2 = (Guint)hint.getInt(); break;
+      }
+      hint.free();
+    }
+  }
+  obj.free();
+
+  // an incremental update invalidates all offsets in the dictionary
+  str->setPos(0, -1);
+  fileLength = str->getPos() - str->getStart();
+  if (length != fileLength) {
+    goto done;
+  }
+  if (endFirstPage > length || mainXRefEntriesOffset >= length) {
+    goto done;
+  }
+
+  ok = findFirstPageXRef(str);
+
+ done:
+  linDict.free();
+  obj3.free();
+  obj2.free();
+  obj1.free();
+  delete parser;
+}
+
+Linearization::~Linearization() {
+}
+
+// The parser reads ahead, so the end of the dictionary object is
+// looked up in the raw data.
+GBool Linearization::findFirstPageXRef(BaseStream *str) {
+  char buf[linearizationSearchSize + 1];
+  char *p;
+  int c, n;
+
+  str->setPos(str->getStart());
+  for (n = 0; n < linearizationSearchSize; ++n) {
+    if ((c = str->getChar()) == EOF) {
+      break;
+    }
+    buf[n] = c ? c : ' ';
+  }
+  buf[n] = '\0';
+
+  if (!(p = strstr(buf, "/Linearized")) || !(p = strstr(p, "endobj"))) {
+    return gFalse;
+  }
+  p += 6;
+  while (*p) {
+    if (isspace(*p)) {
+      ++p;
+    } else if (*p == '%') {
+      while (*p && *p != '\n' && *p != '\r') {
+	++p;
+      }
+    } else {
+      break;
+    }
+  }
+
+  // either an xref table or the header of an xref stream object
+  if (strncmp(p, "xref", 4) && !isdigit(*p)) {
+    return gFalse;
+  }
+  firstPageXRefPos = (Guint)(p - buf);
+  return gTrue;
+}
@@ -0,0 +1,71 @@
+//========================================================================
+//
+// Linearization.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef LINEARIZATION_H
+#define LINEARIZATION_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "goo/gtypes.h"
+#include "Object.h"
+
+class BaseStream;
+
+//------------------------------------------------------------------------
+// Linearization
+//
+// The linearization parameter dictionary at the start of a linearized
+// (web optimized) file, see PDF Reference, Appendix F.
+//------------------------------------------------------------------------
+
+class Linearization {
+public:
+
+  // Parse the first object of <str>.
+  Linearization(BaseStream *str);
+  ~Linearization();
+
+  // Is the first object a usable linearization dictionary?  The file
+  // must still have the length the dictionary was written for, or it
+  // was updated incrementally and the hints are out of date.
+  GBool isOk() { return ok; }
+
+  Guint getLength() { return length; }			// /L
+  Guint getHintsOffset() { return hintsOffset; }	// /H
+  Guint getHintsLength() { return hintsLength; }
+  Guint getHintsOffset2() { return hintsOffset2; }	// 0 if none
+  Guint getHintsLength2() { return hintsLength2; }
+  int getObjectNumberFirst() { return objectNumberFirst; } // /O
+  Guint getEndFirstPage() { return endFirstPage; }	// /E
+  int getNumPages() { return numPages; }		// /N
+  Guint getMainXRefEntriesOffset() { return mainXRefEntriesOffset; } // /T
+  int getPageFirst() { return pageFirst; }		// /P
+
+  // Offset of the first-page xref section, which directly follows the
+  // linearization dictionary.
+  Guint getFirstPageXRefPos() { return firstPageXRefPos; }
+
+private:
+
+  GBool findFirstPageXRef(BaseStream *str);
+
+  GBool ok;
+  Guint length;
+  Guint hintsOffset, hintsLength;
+  Guint hintsOffset2, hintsLength2;
+  int objectNumberFirst;
+  Guint endFirstPage;
+  int numPages;
+  Guint mainXRefEntriesOffset;
+  int pageFirst;
+  Guint firstPageXRefPos;
+};
+
+#endif
@@ -0,0 +1,208 @@
+//========================================================================
+//
+// NameTable.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "goo/gmem.h"
+#include "NameTable.h"
+
+#if MULTITHREADED
+#  define lockTable()   gLockMutex(&mutex)
+#  define unlockTable() gUnlockMutex(&mutex)
+#  define publish()     gMemoryBarrier()
+#else
+#  define lockTable()
+#  define unlockTable()
+#  define publish()
+#endif
+
+//------------------------------------------------------------------------
+// NameTable
+//------------------------------------------------------------------------
+
+// The content stream operators (see Gfx::opTab) and the keywords the
+// parser looks for.
+static const char *keywordNames[] = {
+  "\"",   "'",    "B",    "B*",   "BDC",  "BI",   "BMC",  "BT",
+  "BX",   "CS",   "DP",   "Do",   "EI",   "EMC",  "ET",   "EX",
+  "F",    "G",    "ID",   "J",    "K",    "M",    "MP",   "Q",
+  "RG",   "S",    "SC",   "SCN",  "T*",   "TD",   "TJ",   "TL",
+  "Tc",   "Td",   "Tf",   "Tj",   "Tm",   "Tr",   "Ts",   "Tw",
+  "Tz",   "W",    "W*",   "b",    "b*",   "c",    "cm",   "cs",
+  "d",    "d0",   "d1",   "f",    "f*",   "g",    "gs",   "h",
+  "i",    "j",    "k",    "l",    "m",    "n",    "q",    "re",
+  "rg",   "ri",   "s",    "sc",   "scn",  "sh",   "v",    "w",
+  "y",
+  "[",    "]",    "<<",   ">>",   "R",    "obj",  "endobj",
+  "stream", "endstream", "xref", "trailer", "startxref"
+};
+int NameTable::nKeywords = sizeof(keywordNames) / sizeof(keywordNames[0]);
+NameTableKeyword NameTable::keywords[sizeof(keywordNames) /
+				     sizeof(keywordNames[0])];
+
+NameTableEntry *NameTable::blocks[nameTableMaxBlocks];
+int NameTable::count = 0;
+NameTableHash *NameTable::hashTab = NULL;
+GBool NameTable::initialized = gFalse;
+#if MULTITHREADED
+GooMutex NameTable::mutex;
+#endif
+
+// Set up the table while the library is loaded, before any thread can
+// race for it.  intern() and find() also do it on first use, in case
+// another static constructor gets there first.
+static struct NameTableInit {
+  NameTableInit() { NameTable::find(""); }
+} nameTableInit;
+
+static NameTableHash *newHash(int size) {
+  NameTableHash *h;
+  int i;
+
+  h = (NameTableHash *)gmalloc(sizeof(NameTableHash));
+  h->size = size;
+  h->heads = (int *)gmallocn(size, sizeof(int));
+  for (i = 0; i < size; ++i) {
+    h->heads[i] = -1;
+  }
+  h->next = (int *)gmallocn(2 * size, sizeof(int));
+  h->prev = NULL;
+  return h;
+}
+
+void NameTable::init() {
+  int i;
+
+  initialized = gTrue;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+  hashTab = newHash(1024);
+  // the keywords get atoms 0 .. nKeywords - 1
+  for (i = 0; i < nKeywords; ++i) {
+    keywords[i].atom = i;
+    strcpy(keywords[i].name, keywordNames[i]);
+    add(keywords[i].name, hash(keywords[i].name));
+  }
+}
+
+Guint NameTable::hash(const char *name) {
+  Guint h;
+
+  h = 0;
+  for (; *name; ++name) {
+    h = 31 * h + (*name & 0xff);
+  }
+  return h;
+}
+
+int NameTable::lookup(const char *name, Guint h) {
+  NameTableHash *ht;
+  NameTableEntry *e;
+  int atom;
+
+  ht = hashTab;
+  for (atom = ht->heads[h & (ht->size - 1)]; atom >= 0;
+       atom = ht->next[atom]) {
+    e = &blocks[atom >> nameTableBlockBits][atom & (nameTableBlockSize - 1)];
+    if (e->hash == h && !strcmp(e->name, name)) {
+      return atom;
+    }
+  }
+  return -1;
+}
+
+// Add name string <name>, which the table takes over, as the next atom.
+// The caller holds the lock and has checked that the table isn't full.  Everything a reader can reach is written before the
+// atom is linked in, and hash tables are replaced, never changed in
+// place, so lookup() works without the lock.
+int NameTable::add(char *name, Guint h) {
+  NameTableHash *ht, *ht2;
+  NameTableEntry *e;
+  int atom, b, i;
+
+  atom = count;
+  b = atom >> nameTableBlockBits;
+  if (!blocks[b]) {
+    blocks[b] = (NameTableEntry *)gmallocn(nameTableBlockSize,
+					   sizeof(NameTableEntry));
+  }
+  e = &blocks[b][atom & (nameTableBlockSize - 1)];
+  e->name = name;
+  e->hash = h;
+
+  // keep at most two atoms per bucket on average
+  ht = hashTab;
+  if (atom == 2 * ht->size) {
+    ht2 = newHash(2 * ht->size);
+    for (i = 0; i < atom; ++i) {
+      e = &blocks[i >> nameTableBlockBits][i & (nameTableBlockSize - 1)];
+      ht2->next[i] = ht2->heads[e->hash & (ht2->size - 1)];
+      ht2->heads[e->hash & (ht2->size - 1)] = i;
+    }
+    ht2->prev = ht;
+    publish();
+    hashTab = ht = ht2;
+  }
+
+  ht->next[atom] = ht->heads[h & (ht->size - 1)];
+  publish();
+  ht->heads[h & (ht->size - 1)] = atom;
+  count = atom + 1;
+  return atom;
+}
+
+// Allocate a name string: a copy of <name>, preceded by <atom>.
+char *NameTable::newName(const char *name, int atom) {
+  char *p;
+
+  p = (char *)gmalloc(sizeof(int) + strlen(name) + 1);
+  *(int *)p = atom;
+  strcpy(p + sizeof(int), name);
+  return p + sizeof(int);
+}
+
+char *NameTable::intern(const char *name) {
+  Guint h;
+  int atom;
+
+  if (!initialized) {
+    init();
+  }
+  h = hash(name);
+  if ((atom = lookup(name, h)) < 0) {
+    lockTable();
+    if ((atom = lookup(name, h)) < 0 && count < nameTableMaxNames) {
+      atom = add(newName(name, count), h);
+    }
+    unlockTable();
+    if (atom < 0) {
+      return newName(name, -1);
+    }
+  }
+  return getName(atom);
+}
+
+int NameTable::find(const char *name) {
+  if (!initialized) {
+    init();
+  }
+  return lookup(name, hash(name));
+}
+
+char *NameTable::findKeyword(const char *cmd) {
+  int atom;
+
+  atom = find(cmd);
+  return atom >= 0 && atom < nKeywords ? keywords[atom].name : (char *)NULL;
+}
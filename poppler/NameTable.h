@@ -0,0 +1,142 @@
+//========================================================================
+//
+// NameTable.h
+//
+// Process-wide table of interned PDF names.  Each distinct name gets a
+// small integer atom, and a single copy of the string that lives as
+// long as the process.  The content stream operators and the parser
+// keywords are interned up front; other commands are not interned.
+//
+// The strings handed out for names (name strings) carry their atom in
+// the int right before the first character, so that getAtom() is a
+// single load.  Names that don't fit in a full table get an owned name
+// string with atom -1 instead.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef NAMETABLE_H
+#define NAMETABLE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "poppler-config.h"
+#include "goo/gtypes.h"
+#include "goo/gmem.h"
+
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
+// The names are kept in blocks that are never moved, so that
+// getName() and find() don't need the lock.
+#define nameTableBlockBits 10
+#define nameTableBlockSize (1 << nameTableBlockBits)
+#define nameTableMaxBlocks 1024
+
+// Interned names are never freed, so the table only grows, by the
+// length of each new name plus about 40 bytes.  It holds at most
+// nameTableMaxNames names (some 50 MB with names of average length).
+// Once it is full, intern() returns owned name strings for new names,
+// which are freed with the objects and dicts that use them.
+#define nameTableMaxNames (nameTableMaxBlocks * nameTableBlockSize)
+
+// Room for the longest keyword, including the terminating null.
+#define nameTableKeywordSize 10
+
+struct NameTableKeyword {
+  int atom;
+  char name[nameTableKeywordSize];
+};
+
+struct NameTableEntry {
+  char *name;
+  Guint hash;
+};
+
+// Hash chains over the atoms.  A larger one replaces it when the table
+// grows; the old one is kept, as find() may still be walking it.
+struct NameTableHash {
+  int size;			// number of buckets (a power of two)
+  int *heads;			// first atom in each bucket, or -1
+  int *next;			// next atom in the same bucket, or -1
+				//   (2 * size entries)
+  NameTableHash *prev;		// the hash this one replaced
+};
+
+//------------------------------------------------------------------------
+// NameTable
+//------------------------------------------------------------------------
+
+class NameTable {
+public:
+
+  // Return the name string for <name>, adding it to the table if
+  // needed.  If the table is full, this is an owned copy with atom -1,
+  // to be freed with freeName().
+  static char *intern(const char *name);
+
+  // Return a name string equal to <name>, which must be a name string:
+  // <name> itself if it is interned, otherwise an owned copy.
+  static char *copyName(char *name)
+    { return getAtom(name) >= 0 ? name : newName(name, -1); }
+
+  // Free a name string returned by intern() or copyName().
+  static void freeName(char *name)
+    { if (getAtom(name) < 0) gfree(name - sizeof(int)); }
+
+  // Return the atom of name string <name>, or -1 if it is not interned.
+  static int getAtom(const char *name) { return ((const int *)name)[-1]; }
+
+  // Return the atom of <name>, or -1 if it was never interned.  Until
+  // the table is full, no dict key or name object can be equal to a
+  // string that isn't in it.  This doesn't take the lock.
+  static int find(const char *name);
+
+  // Return the name string of <atom>.  The string must not be modified
+  // or freed.
+  static char *getName(int atom)
+    { return blocks[atom >> nameTableBlockBits]
+	           [atom & (nameTableBlockSize - 1)].name; }
+
+  // Number of atoms handed out so far.
+  static int getCount() { return count; }
+
+  // Whether new names get owned name strings.
+  static GBool isFull() { return count == nameTableMaxNames; }
+
+  // The keywords (operators and parser keywords) get the first atoms,
+  // and their strings are kept in a single array, so that a command can
+  // tell them from a string it owns.  Return the table's string for
+  // keyword <cmd>, or NULL if <cmd> is not a keyword.
+  static char *findKeyword(const char *cmd);
+
+  // Return the atom of <cmd> if it is a string returned by
+  // findKeyword(), otherwise -1.
+  static int getKeywordAtom(const char *cmd)
+    { return cmd >= keywords[0].name && cmd < (char *)(keywords + nKeywords)
+	       ? getAtom(cmd) : -1; }
+
+private:
+
+  static void init();
+  static Guint hash(const char *name);
+  static int lookup(const char *name, Guint h);
+  static int add(char *name, Guint h);
+  static char *newName(const char *name, int atom);
+
+  static NameTableKeyword keywords[];
+  static int nKeywords;
+  static NameTableEntry *blocks[nameTableMaxBlocks];
+  static int count;		// number of atoms
+  static NameTableHash *hashTab;
+  static GBool initialized;
+#if MULTITHREADED
+  static GooMutex mutex;
+#endif
+};
+
+#endif
@@ -0,0 +1,64 @@
+//========================================================================
+//
+// NetStats.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "NetStats.h"
+
+//------------------------------------------------------------------------
+// NetStats
+//------------------------------------------------------------------------
+
+void NetStats::clear() {
+  memset(this, 0, sizeof(NetStats));
+}
+
+void NetStats::addRequestTime(double seconds) {
+  double limit;
+  int i;
+
+  limit = 0.001;
+  for (i = 0; i < netStatsTimeBuckets - 1 && seconds >= limit; ++i) {
+    limit *= 2;
+  }
+  ++requestTimes[i];
+}
+
+void NetStats::print(FILE *f) {
+  int limit, last, i;
+
+  fprintf(f, "Requests:       %d (%d failed)\n", requests, failedRequests);
+  fprintf(f, "Requested:      %lu bytes\n", (unsigned long)bytesRequested);
+  fprintf(f, "Received:       %lu bytes\n", (unsigned long)bytesReceived);
+  fprintf(f, "Used:           %lu bytes", (unsigned long)bytesUsed);
+  if (bytesReceived > 0) {
+    fprintf(f, " (%.1f%% of received)",
+	    100.0 * (double)bytesUsed / (double)bytesReceived);
+  }
+  fprintf(f, "\n");
+  fprintf(f, "Refetched:      %lu bytes\n", (unsigned long)bytesRefetched);
+  fprintf(f, "Chunk hits:     %d\n", chunkHits);
+  fprintf(f, "Chunk misses:   %d\n", chunkMisses);
+  fprintf(f, "Wait time:      %.3f s\n", waitTime);
+
+  for (last = netStatsTimeBuckets - 1; last > 0 && !requestTimes[last]; --last) ;
+  fprintf(f, "Request times:");
+  for (i = 0, limit = 1; i <= last; ++i, limit *= 2) {
+    if (i == netStatsTimeBuckets - 1) {
+      fprintf(f, " >=%dms:%d", limit / 2, requestTimes[i]);
+    } else {
+      fprintf(f, " <%dms:%d", limit, requestTimes[i]);
+    }
+  }
+  fprintf(f, "\n");
+}
@@ -0,0 +1,53 @@
+//========================================================================
+//
+// NetStats.h
+//
+// Counters for the network traffic of a remote document.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef NETSTATS_H
+#define NETSTATS_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stdio.h>
+#include <stddef.h>
+#include "goo/gtypes.h"
+
+// Number of buckets in the request time histogram.  Bucket 0 counts
+// the requests that took less than 1 ms, bucket i the ones that took
+// from 2^(i-1) up to 2^i ms, and the last bucket everything slower.
+#define netStatsTimeBuckets 16
+
+//------------------------------------------------------------------------
+// NetStats
+//------------------------------------------------------------------------
+
+struct NetStats {
+  int requests;			// HTTP requests issued
+  int failedRequests;		// requests that failed
+  size_t bytesRequested;	// bytes asked for in Range headers
+  size_t bytesReceived;		// body bytes that arrived
+  size_t bytesUsed;		// bytes of the chunks that were read
+  size_t bytesRefetched;	// loaded bytes requested again to merge
+				//   two ranges into one
+  int chunkHits;		// chunks that were loaded when read
+  int chunkMisses;		// chunks that had to be requested or
+				//   waited for when read
+  double waitTime;		// seconds readers waited for data
+  int requestTimes[netStatsTimeBuckets];
+
+  void clear();
+
+  // Count a request that took <seconds>.
+  void addRequestTime(double seconds);
+
+  void print(FILE *f);
+};
+
+#endif
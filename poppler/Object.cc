@@ -92,7 +92,7 @@ Object *Object::copy(Object *obj) {
     obj->string = string->copy();
     break;
   case objName:
-    obj->name = copyString(name);
+    obj->name = NameTable::copyName(name);
     break;
   case objArray:
     array->incRef();
@@ -104,7 +104,9 @@ Object *Object::copy(Object *obj) {
     stream->incRef();
     break;
   case objCmd:
-    obj->cmd = copyString(cmd);
+    if (NameTable::getKeywordAtom(cmd) < 0) {
+      obj->cmd = copyString(cmd);
+    }
     break;
   default:
     break;
@@ -126,7 +128,7 @@ void Object::free() {
     delete string;
     break;
   case objName:
-    gfree(name);
+    NameTable::freeName(name);
     break;
   case objArray:
     if (!array->decRef()) {
@@ -144,7 +146,9 @@ void Object::free() {
     }
     break;
   case objCmd:
-    gfree(cmd);
+    if (NameTable::getKeywordAtom(cmd) < 0) {
+      gfree(cmd);
+    }
     break;
   default:
     break;
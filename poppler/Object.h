@@ -36,6 +36,7 @@
 #include "goo/gmem.h"
 #include "goo/GooString.h"
 #include "Error.h"
+#include "NameTable.h"
 
 #if defined(__GNUC__) && (__GNUC__ > 2) && defined(__OPTIMIZE__)
 # define likely(x)      __builtin_expect((x), 1)
@@ -114,7 +115,7 @@ enum ObjType {
 class Object {
 public:
   // clear the anonymous union as best we can -- clear at least a pointer
-  void zeroUnion() { this->name = NULL; }
+  void zeroUnion() { this->string = NULL; }
 
   // Default constructor.
   Object():
@@ -130,7 +131,7 @@ public:
   Object *initString(GooString *stringA)
     { initObj(objString); string = stringA; return this; }
   Object *initName(char *nameA)
-    { initObj(objName); name = copyString(nameA); return this; }
+    { initObj(objName); name = NameTable::intern(nameA); return this; }
   Object *initNull()
     { initObj(objNull); return this; }
   Object *initArray(XRef *xref);
@@ -139,8 +140,12 @@ public:
   Object *initStream(Stream *streamA);
   Object *initRef(int numA, int genA)
     { initObj(objRef); ref.num = numA; ref.gen = genA; return this; }
+  // Keywords point to the name table's string, other commands own a
+  // copy.
   Object *initCmd(char *cmdA)
-    { initObj(objCmd); cmd = copyString(cmdA); return this; }
+    { initObj(objCmd);
+      if (!(cmd = NameTable::findKeyword(cmdA))) cmd = copyString(cmdA);
+      return this; }
   Object *initError()
     { initObj(objError); return this; }
   Object *initEOF()
@@ -200,6 +205,9 @@ public:
   int getRefNum() { OBJECT_TYPE_CHECK(objRef); return ref.num; }
   int getRefGen() { OBJECT_TYPE_CHECK(objRef); return ref.gen; }
   char *getCmd() { OBJECT_TYPE_CHECK(objCmd); return cmd; }
+  // Atom of a keyword command, -1 for other commands.
+  int getCmdAtom()
+    { OBJECT_TYPE_CHECK(objCmd); return NameTable::getKeywordAtom(cmd); }
 
   // Array accessors.
   int arrayGetLength();
@@ -244,7 +252,7 @@ private:
     int intg;			//   integer
     double real;		//   real
     GooString *string;		//   string
-    char *name;			//   name
+    char *name;			//   name (a name string, see NameTable)
     Array *array;		//   array
     Dict *dict;			//   dictionary
     Stream *stream;		//   stream
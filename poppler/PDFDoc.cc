@@ -52,6 +52,8 @@
 #include "Stream.h"
 #include "XRef.h"
 #include "Link.h"
+#include "Linearization.h"
+#include "Hints.h"
 #include "OutputDev.h"
 #include "Error.h"
 #include "ErrorCodes.h"
@@ -89,6 +91,9 @@ PDFDoc::PDFDoc(GooString *fileNameA, GooString *ownerPassword,
   str = NULL;
   xref = NULL;
   catalog = NULL;
+  linearization = NULL;
+  hints = NULL;
+  curlCache = NULL;
 #ifndef DISABLE_OUTLINE
   outline = NULL;
 #endif
@@ -99,13 +104,13 @@ PDFDoc::PDFDoc(GooString *fileNameA, GooString *ownerPassword,
     errCode = errOpenFile;
     return;
 #else
-  	CurlCache *cc = new CurlCache(fileNameA);
+  	curlCache = new CurlCache(fileNameA);
   	
-  	fileName = cc->getFileName();
+  	fileName = curlCache->getFileName();
   	
     // create streamObject obj;
     obj.initNull();
-    str = new HttpStream(cc, 0, gFalse, 0, &obj);
+    str = new HttpStream(curlCache, 0, gFalse, 0, &obj);
 #endif
   } else {
     fileName = fileNameA;
@@ -152,6 +157,9 @@ PDFDoc::PDFDoc(wchar_t *fileNameA, int fileNameLen, GooString *ownerPassword,
   str = NULL;
   xref = NULL;
   catalog = NULL;
+  linearization = NULL;
+  hints = NULL;
+  curlCache = NULL;
 #ifndef DISABLE_OUTLINE
   outline = NULL;
 #endif
@@ -205,6 +213,9 @@ PDFDoc::PDFDoc(BaseStream *strA, GooString *ownerPassword,
   str = strA;
   xref = NULL;
   catalog = NULL;
+  linearization = NULL;
+  hints = NULL;
+  curlCache = NULL;
 #ifndef DISABLE_OUTLINE
   outline = NULL;
 #endif
@@ -229,7 +240,21 @@ GBool PDFDoc::setup(GooString *ownerPassword, GooString *userPassword) {
   checkHeader();
 
   // read xref table
-  xref = new XRef(str);
+  if (str->getKind() == strHttp) {
+    linearization = new Linearization(str);
+  }
+  if (linearization && linearization->isOk()) {
+    // everything the first page needs is at the start of the file:
+    // request it in one piece, followed by the main xref table, which
+    // keeps loading while the first page is parsed
+    str->preload(str->getStart(),
+		 str->getStart() + linearization->getEndFirstPage());
+    str->preload(str->getStart() + linearization->getMainXRefEntriesOffset(),
+		 str->getStart() + linearization->getLength());
+    xref = new XRef(str, linearization->getFirstPageXRefPos());
+  } else {
+    xref = new XRef(str);
+  }
   if (!xref->isOk()) {
     error(-1, "Couldn't read xref table");
     errCode = xref->getErrorCode();
@@ -243,7 +268,10 @@ GBool PDFDoc::setup(GooString *ownerPassword, GooString *userPassword) {
   }
 
   // read catalog
-  catalog = new Catalog(xref);
+  if (linearization && linearization->isOk()) {
+    hints = new Hints(str, linearization, xref);
+  }
+  catalog = new Catalog(xref, hints);
   if (!catalog->isOk()) {
     error(-1, "Couldn't read page catalog");
     errCode = errBadCatalog;
@@ -271,9 +299,21 @@ PDFDoc::~PDFDoc() {
   if (xref) {
     delete xref;
   }
+  if (hints) {
+    delete hints;
+  }
+  if (linearization) {
+    delete linearization;
+  }
   if (str) {
     delete str;
   }
+#ifdef ENABLE_LIBCURL
+  // the streams only borrow the cache
+  if (curlCache) {
+    delete curlCache;
+  }
+#endif
   if (file) {
     fclose(file);
   }
@@ -441,6 +481,10 @@ void PDFDoc::processLinks(OutputDev *out, int page) {
   catalog->getPage(page)->processLinks(out, catalog);
 }
 
+GBool PDFDoc::getNetStats(NetStats *stats) {
+  return str->getNetStats(stats);
+}
+
 GBool PDFDoc::isLinearized() {
   Parser *parser;
   Object obj1, obj2, obj3, obj4, obj5;
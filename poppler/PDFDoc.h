@@ -42,11 +42,15 @@
 
 class GooString;
 class BaseStream;
+class CurlCache;
+struct NetStats;
 class OutputDev;
 class Links;
 class LinkAction;
 class LinkDest;
 class Outline;
+class Linearization;
+class Hints;
 
 enum PDFWriteMode {
   writeStandard,
@@ -98,6 +102,10 @@ public:
   // Get base stream.
   BaseStream *getBaseStream() { return str; }
 
+  // Get the network traffic counters of a remote document.  Returns
+  // false for local files.
+  GBool getNetStats(NetStats *stats);
+
   // Get page parameters.
   double getPageMediaWidth(int page)
     { return catalog->getPage(page)->getMediaWidth(); }
@@ -235,11 +243,14 @@ private:
   GooString *fileName;
   FILE *file;
   BaseStream *str;
+  CurlCache *curlCache;		// NULL unless opened from a URL
   void *guiData;
   int pdfMajorVersion;
   int pdfMinorVersion;
   XRef *xref;
   Catalog *catalog;
+  Linearization *linearization;	// NULL unless read over HTTP
+  Hints *hints;			// NULL unless linearized
 #ifndef DISABLE_OUTLINE
   Outline *outline;
 #endif
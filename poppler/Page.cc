@@ -37,6 +37,7 @@
 #endif
 
 #include <stddef.h>
+#include <string.h>
 #include <limits.h>
 #include "GlobalParams.h"
 #include "Object.h"
@@ -57,6 +58,11 @@
 #include "Catalog.h"
 #include "Form.h"
 
+//------------------------------------------------------------------------
+
+#define pagePrefetchMaxWaves 4		// request batches per page
+#define pagePrefetchMaxObjects 1024	// objects prefetched per page
+
 //------------------------------------------------------------------------
 // PDFRectangle
 //------------------------------------------------------------------------
@@ -260,6 +266,7 @@ Page::Page(XRef *xrefA, int numA, Dict *pageDict, Ref pageRefA, PageAttrs *attrs
   num = numA;
   duration = -1;
   pageWidgets = NULL;
+  prefetched = gFalse;
 
   pageObj.initDict(pageDict);
   pageRef = pageRefA;
@@ -462,6 +469,10 @@ void Page::displaySlice(OutputDev *out, double hDPI, double vDPI,
     return;
   }
 
+  if (xref->getBaseStream()->getKind() == strHttp) {
+    prefetchResources();
+  }
+
   gfx = createGfx(out, hDPI, vDPI, rotate, useMediaBox, crop,
 		  sliceX, sliceY, sliceW, sliceH,
 		  printing, catalog,
@@ -511,6 +522,145 @@ void Page::display(Gfx *gfx) {
   obj.free();
 }
 
+//------------------------------------------------------------------------
+// resource prefetching
+//------------------------------------------------------------------------
+
+// Resource categories that are followed from the page's resource dict.
+static const char *prefetchResourceKeys[] = {
+  "Font",
+  "XObject",
+  "Pattern",
+  "Shading",
+  "ExtGState",
+  NULL
+};
+
+// Keys that lead up the page tree or to other pages (actions and
+// destinations), and are not followed.
+static const char *prefetchSkipKeys[] = {
+  "Parent",
+  "P",
+  "A",
+  "AA",
+  "D",
+  "Dest",
+  "Dests",
+  "Next",
+  NULL
+};
+
+class PrefetchRefs {
+public:
+
+  PrefetchRefs(int nObjectsA);
+  ~PrefetchRefs();
+
+  // Add all references in <obj>, looking into direct arrays and
+  // dictionaries.  Page tree nodes are not looked into.
+  void collect(Object *obj);
+
+  int nObjects;
+  char *seen;
+  Ref *refs;
+  int nRefs;
+  int refsSize;
+};
+
+PrefetchRefs::PrefetchRefs(int nObjectsA) {
+  nObjects = nObjectsA;
+  seen = (char *)gmallocn(nObjects > 0 ? nObjects : 1, sizeof(char));
+  memset(seen, 0, nObjects);
+  refs = NULL;
+  nRefs = refsSize = 0;
+}
+
+PrefetchRefs::~PrefetchRefs() {
+  gfree(seen);
+  gfree(refs);
+}
+
+void PrefetchRefs::collect(Object *obj) {
+  Object obj1;
+  Dict *dict;
+  char *key;
+  int num, i, j;
+
+  if (obj->isRef()) {
+    num = obj->getRefNum();
+    if (num < 0 || num >= nObjects || seen[num] ||
+	nRefs >= pagePrefetchMaxObjects) {
+      return;
+    }
+    seen[num] = 1;
+    if (nRefs == refsSize) {
+      refsSize = refsSize ? 2 * refsSize : 64;
+      refs = (Ref *)greallocn(refs, refsSize, sizeof(Ref));
+    }
+    refs[nRefs++] = obj->getRef();
+  } else if (obj->isArray()) {
+    for (i = 0; i < obj->arrayGetLength(); ++i) {
+      collect(obj->arrayGetNF(i, &obj1));
+      obj1.free();
+    }
+  } else if (obj->isDict("Page") || obj->isDict("Pages")) {
+    return;
+  } else if (obj->isDict() || obj->isStream()) {
+    dict = obj->isDict() ? obj->getDict() : obj->streamGetDict();
+    for (i = 0; i < dict->getLength(); ++i) {
+      key = dict->getKey(i);
+      for (j = 0; prefetchSkipKeys[j]; ++j) {
+	if (!strcmp(key, prefetchSkipKeys[j])) {
+	  break;
+	}
+      }
+      if (!prefetchSkipKeys[j]) {
+	collect(dict->getValNF(i, &obj1));
+	obj1.free();
+      }
+    }
+  }
+}
+
+void Page::prefetchResources() {
+  PrefetchRefs *refs;
+  Dict *resDict;
+  Object obj1;
+  int wave, start, end, i;
+
+  if (prefetched) {
+    return;
+  }
+  prefetched = gTrue;
+
+  refs = new PrefetchRefs(xref->getNumObjects());
+  refs->collect(&contents);
+  if ((resDict = getResourceDict())) {
+    for (i = 0; prefetchResourceKeys[i]; ++i) {
+      refs->collect(resDict->lookupNF((char *)prefetchResourceKeys[i],
+				      &obj1));
+      obj1.free();
+    }
+  }
+
+  // each wave loads the objects found in the previous one with a single
+  // batch of requests
+  start = 0;
+  for (wave = 0; wave < pagePrefetchMaxWaves && start < refs->nRefs; ++wave) {
+    end = refs->nRefs;
+    xref->preloadObjects(end - start, refs->refs + start);
+    if (wave < pagePrefetchMaxWaves - 1) {
+      for (i = start; i < end; ++i) {
+	xref->fetch(refs->refs[i].num, refs->refs[i].gen, &obj1);
+	refs->collect(&obj1);
+	obj1.free();
+      }
+    }
+    start = end;
+  }
+  delete refs;
+}
+
 GBool Page::loadThumb(unsigned char **data_out,
 		      int *width_out, int *height_out,
 		      int *rowstride_out)
@@ -223,6 +223,16 @@ public:
 
   void display(Gfx *gfx);
 
+  // Load the objects the page refers to (contents, resources and the
+  // objects they refer to in turn) from a remote file in a few batched
+  // requests, so that displaying it does not wait for each object in
+  // turn.  Streams are not decoded.  Only the first call does anything.
+  void prefetchResources();
+
+  // Mark the page's objects as loaded already, e.g. from the hint
+  // tables of a linearized file, so prefetchResources() is skipped.
+  void setPrefetched() { prefetched = gTrue; }
+
   void makeBox(double hDPI, double vDPI, int rotate,
 	       GBool useMediaBox, GBool upsideDown,
 	       double sliceX, double sliceY, double sliceW, double sliceH,
@@ -251,6 +261,7 @@ private:
   Object trans;			// page transition
   Object actions;		// page addiction actions
   double duration;              // page duration
+  GBool prefetched;		// prefetchResources() was done
   GBool ok;			// true if page is valid
 };
 
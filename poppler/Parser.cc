@@ -92,14 +92,14 @@ Object *Parser::getObj(Object *obj, Guchar *fileKey,
 	error(getPos(), "Dictionary key must be a name object");
 	shift();
       } else {
-	// buf1 might go away in shift(), so construct the key
-	key = copyString(buf1.getName());
+	// buf1 might go away in shift(), so keep the key
+	key = NameTable::copyName(buf1.getName());
 	shift();
 	if (buf1.isEOF() || buf1.isError()) {
-	  gfree(key);
+	  NameTable::freeName(key);
 	  break;
 	}
-	obj->dictAdd(key, getObj(&obj2, fileKey, encAlgorithm, keyLength, objNum, objGen));
+	obj->getDict()->addName(key, getObj(&obj2, fileKey, encAlgorithm, keyLength, objNum, objGen));
       }
     }
     if (buf1.isEOF())
@@ -12,6 +12,7 @@
 
 #include "PopplerCache.h"
 
+#include "goo/gmem.h"
 #include "XRef.h"
 
 PopplerCacheKey::~PopplerCacheKey()
@@ -104,60 +105,161 @@ PopplerCacheKey *PopplerCache::key(int index)
   return keys[index];
 }
 
-class ObjectKey : public PopplerCacheKey {
-  public:
-    ObjectKey(int numA, int genA) : num(numA), gen(genA)
-    {
-    }
+struct PopplerObjectCacheEntry {
+  Ref ref;
+  Object obj;
+  int hashNext;			// next entry in the same hash chain
+  int prev, next;		// neighbours in use order, or the next
+				//   unused entry
+};
 
-    bool operator==(const PopplerCacheKey &key) const
-    {
-      const ObjectKey *k = static_cast<const ObjectKey*>(&key);
-      return k->num == num && k->gen == gen;
-    }
+static inline int hashRef(const Ref &ref, int nBuckets) {
+  return (int)(((unsigned)ref.num * 31 + (unsigned)ref.gen) &
+	       (unsigned)(nBuckets - 1));
+}
 
-    int num, gen;
-};
+PopplerObjectCache::PopplerObjectCache(int cacheSizeA, XRef *xrefA) {
+  int i;
 
-class ObjectItem : public PopplerCacheItem {
-  public:
-    ObjectItem(Object *obj)
-    {
-      obj->copy(&item);
-    }
+  xref = xrefA;
+  cacheSize = cacheSizeA < 1 ? 1 : cacheSizeA;
+  entries = (PopplerObjectCacheEntry *)
+      gmallocn(cacheSize, sizeof(PopplerObjectCacheEntry));
+  for (i = 0; i < cacheSize; ++i) {
+    entries[i].obj.initNull();
+  }
+  for (nBuckets = 1; nBuckets < 2 * cacheSize; nBuckets <<= 1) ;
+  buckets = (int *)gmallocn(nBuckets, sizeof(int));
+  first = -1;
+  hits = misses = 0;
+  clear();
+}
 
-    ~ObjectItem()
-    {
-      item.free();
+PopplerObjectCache::~PopplerObjectCache() {
+  clear();
+  gfree(entries);
+  gfree(buckets);
+}
+
+void PopplerObjectCache::clear() {
+  int i;
+
+  for (i = first; i >= 0; i = entries[i].next) {
+    entries[i].obj.free();
+  }
+  for (i = 0; i < nBuckets; ++i) {
+    buckets[i] = -1;
+  }
+  for (i = 0; i < cacheSize; ++i) {
+    entries[i].next = i + 1 < cacheSize ? i + 1 : -1;
+  }
+  freeEntry = 0;
+  first = last = -1;
+  nItems = 0;
+}
+
+int PopplerObjectCache::find(const Ref &ref) {
+  int i;
+
+  for (i = buckets[hashRef(ref, nBuckets)]; i >= 0; i = entries[i].hashNext) {
+    if (entries[i].ref.num == ref.num && entries[i].ref.gen == ref.gen) {
+      return i;
     }
+  }
+  return -1;
+}
 
-    Object item;
-};
+// Take an entry out of the use order.
+void PopplerObjectCache::unlinkEntry(int index) {
+  PopplerObjectCacheEntry *e = &entries[index];
 
-PopplerObjectCache::PopplerObjectCache(int cacheSize, XRef *xrefA) {
-  cache = new PopplerCache (cacheSize);
-  xref = xrefA;
+  if (e->prev >= 0) {
+    entries[e->prev].next = e->next;
+  } else {
+    first = e->next;
+  }
+  if (e->next >= 0) {
+    entries[e->next].prev = e->prev;
+  } else {
+    last = e->prev;
+  }
 }
 
-PopplerObjectCache::~PopplerObjectCache() {
-  delete cache;
+// Make an entry the most recently used one.
+void PopplerObjectCache::linkEntry(int index) {
+  entries[index].prev = -1;
+  entries[index].next = first;
+  if (first >= 0) {
+    entries[first].prev = index;
+  } else {
+    last = index;
+  }
+  first = index;
+}
+
+void PopplerObjectCache::removeEntry(int index) {
+  PopplerObjectCacheEntry *e = &entries[index];
+  int *p;
+
+  for (p = &buckets[hashRef(e->ref, nBuckets)]; *p != index;
+       p = &entries[*p].hashNext) ;
+  *p = e->hashNext;
+  unlinkEntry(index);
+  e->obj.free();
+  e->next = freeEntry;
+  freeEntry = index;
+  --nItems;
 }
 
 Object *PopplerObjectCache::put(const Ref &ref) {
   Object obj;
-  xref->fetch(ref.num, ref.gen, &obj);
+  Object *item;
 
-  ObjectKey *key = new ObjectKey(ref.num, ref.gen);
-  ObjectItem *item = new ObjectItem(&obj);
-  cache->put(key, item);
+  xref->fetch(ref.num, ref.gen, &obj);
+  item = put(ref, &obj);
   obj.free();
+  return item;
+}
 
-  return &item->item;
+Object *PopplerObjectCache::put(const Ref &ref, Object *obj) {
+  int h, i;
+
+  if ((i = find(ref)) >= 0) {
+    removeEntry(i);
+  } else if (freeEntry < 0) {
+    removeEntry(last);
+  }
+  i = freeEntry;
+  freeEntry = entries[i].next;
+  entries[i].ref = ref;
+  obj->copy(&entries[i].obj);
+  h = hashRef(ref, nBuckets);
+  entries[i].hashNext = buckets[h];
+  buckets[h] = i;
+  linkEntry(i);
+  ++nItems;
+  return &entries[i].obj;
 }
 
 Object *PopplerObjectCache::lookup(const Ref &ref, Object *obj) {
-  ObjectKey key(ref.num, ref.gen);
-  ObjectItem *item = static_cast<ObjectItem *>(cache->lookup(key));
+  int i;
 
-  return item ? item->item.copy(obj) : obj->initNull();
+  if ((i = find(ref)) < 0) {
+    ++misses;
+    return obj->initNull();
+  }
+  ++hits;
+  if (i != first) {
+    unlinkEntry(i);
+    linkEntry(i);
+  }
+  return entries[i].obj.copy(obj);
+}
+
+void PopplerObjectCache::remove(const Ref &ref) {
+  int i;
+
+  if ((i = find(ref)) >= 0) {
+    removeEntry(i);
+  }
 }
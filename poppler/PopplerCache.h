@@ -61,18 +61,60 @@ class PopplerCache
     int cacheSize;
 };
 
+struct PopplerObjectCacheEntry;
+
+// Objects indexed by their reference.  Lookups go through a hash table
+// and the least recently used object is dropped when the cache is full,
+// so both take constant time.
 class PopplerObjectCache
 {
   public:
     PopplerObjectCache (int cacheSizeA, XRef *xrefA);
     ~PopplerObjectCache();
 
+    /* Fetch the object and keep it.  The object returned is owned by
+       the cache */
     Object *put(const Ref &ref);
+
+    /* Keep a copy of obj.  The object returned is owned by the cache */
+    Object *put(const Ref &ref, Object *obj);
+
+    /* Copy the object to obj, or set obj to null if it is not cached */
     Object *lookup(const Ref &ref, Object *obj);
 
+    /* Drop the object if it is cached */
+    void remove(const Ref &ref);
+
+    /* Drop all objects */
+    void clear();
+
+    /* The max size of the cache */
+    int size() { return cacheSize; }
+
+    /* The number of objects in the cache */
+    int numberOfItems() { return nItems; }
+
+    /* Lookups that found the object and lookups that did not */
+    int getHits() { return hits; }
+    int getMisses() { return misses; }
+
   private:
+    PopplerObjectCache(const PopplerObjectCache &cache); // not allowed
+
+    int find(const Ref &ref);
+    void unlinkEntry(int index);
+    void linkEntry(int index);
+    void removeEntry(int index);
+
     XRef *xref;
-    PopplerCache *cache;
+    PopplerObjectCacheEntry *entries;
+    int *buckets;		// first entry of each hash chain, -1 if none
+    int nBuckets;		// a power of two
+    int cacheSize;
+    int nItems;
+    int first, last;		// most and least recently used entry
+    int freeEntry;		// chain of unused entries
+    int hits, misses;
 };
 
 #endif
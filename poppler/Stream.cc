@@ -96,10 +96,49 @@ int Stream::getRawChar() {
   return EOF;
 }
 
+int Stream::getChars(int nChars, Guchar *buffer) {
+  int n, c;
+
+  for (n = 0; n < nChars; ++n) {
+    if ((c = getChar()) == EOF) {
+      break;
+    }
+    buffer[n] = (Guchar)c;
+  }
+  return n;
+}
+
 char *Stream::getLine(char *buf, int size) {
-  int i;
+  Guchar *span;
+  int i, j, n;
   int c;
 
+  // scan the decoded data in place where the stream allows it
+  if ((n = lookSpan(&span)) >= 0) {
+    if (n == 0) {
+      return NULL;
+    }
+    i = 0;
+    while (i < size - 1 && n > 0) {
+      for (j = 0; j < n && i < size - 1; ++j) {
+	if (span[j] == '\n' || span[j] == '\r') {
+	  c = span[j];
+	  skipSpan(j + 1);
+	  if (c == '\r' && lookChar() == '\n') {
+	    getChar();
+	  }
+	  buf[i] = '\0';
+	  return buf;
+	}
+	buf[i++] = span[j];
+      }
+      skipSpan(j);
+      n = lookSpan(&span);
+    }
+    buf[i] = '\0';
+    return buf;
+  }
+
   if (lookChar() == EOF)
     return NULL;
   for (i = 0; i < size - 1; ++i) {
@@ -410,10 +449,23 @@ ImageStream::ImageStream(Stream *strA, int widthA, int nCompsA, int nBitsA) {
     imgLineSize = -1;
   }
   imgLine = (Guchar *)gmallocn(imgLineSize, sizeof(Guchar));
+  if (nBits == 8) {
+    inputLineSize = 0;
+    inputLine = NULL;
+  } else {
+    if (nVals > (INT_MAX - 7) / nBits) {
+      // force a call to gmallocn(-1,...), which will throw an exception
+      inputLineSize = -1;
+    } else {
+      inputLineSize = (nVals * nBits + 7) >> 3;
+    }
+    inputLine = (Guchar *)gmallocn(inputLineSize, sizeof(Guchar));
+  }
   imgIdx = nVals;
 }
 
 ImageStream::~ImageStream() {
+  gfree(inputLine);
   gfree(imgLine);
 }
 
@@ -442,11 +494,24 @@ Guchar *ImageStream::getLine() {
   Gulong buf, bitMask;
   int bits;
   int c;
-  int i;
-
+  int i, n;
+  Guchar *p;
+
+  // a short read at end of stream leaves the rest of the line filled
+  // with EOF bytes, as the per-char loop did
+  if (nBits == 8) {
+    if ((n = str->getChars(nVals, imgLine)) < nVals) {
+      memset(imgLine + n, 0xff, nVals - n);
+    }
+    return imgLine;
+  }
+  if ((n = str->getChars(inputLineSize, inputLine)) < inputLineSize) {
+    memset(inputLine + n, 0xff, inputLineSize - n);
+  }
+  p = inputLine;
   if (nBits == 1) {
     for (i = 0; i < nVals; i += 8) {
-      c = str->getChar();
+      c = *p++;
       imgLine[i+0] = (Guchar)((c >> 7) & 1);
       imgLine[i+1] = (Guchar)((c >> 6) & 1);
       imgLine[i+2] = (Guchar)((c >> 5) & 1);
@@ -456,19 +521,14 @@ Guchar *ImageStream::getLine() {
       imgLine[i+6] = (Guchar)((c >> 1) & 1);
       imgLine[i+7] = (Guchar)(c & 1);
     }
-  } else if (nBits == 8) {
-    Guchar *line = imgLine;
-    for (i = 0; i < nVals; ++i) {
-      *line++ = str->getChar();
-    }
   } else if (nBits == 16) {
     // this is a hack to support 16 bits images, everywhere
     // we assume a component fits in 8 bits, with this hack
     // we treat 16 bit images as 8 bit ones until it's fixed correctly.
     // The hack has another part on GfxImageColorMap::GfxImageColorMap
     for (i = 0; i < nVals; ++i) {
-      imgLine[i] = str->getChar();
-      str->getChar();
+      imgLine[i] = *p;
+      p += 2;
     }
   } else {
     bitMask = (1 << nBits) - 1;
@@ -476,7 +536,7 @@ Guchar *ImageStream::getLine() {
     bits = 0;
     for (i = 0; i < nVals; ++i) {
       if (bits < nBits) {
-	buf = (buf << 8) | (str->getChar() & 0xff);
+	buf = (buf << 8) | *p++;
 	bits += 8;
       }
       imgLine[i] = (Guchar)((buf >> (bits - nBits)) & bitMask);
@@ -487,11 +547,10 @@ Guchar *ImageStream::getLine() {
 }
 
 void ImageStream::skipLine() {
-  int n, i;
-
-  n = (nVals * nBits + 7) >> 3;
-  for (i = 0; i < n; ++i) {
-    str->getChar();
+  if (nBits == 8) {
+    str->getChars(nVals, imgLine);
+  } else {
+    str->getChars(inputLineSize, inputLine);
   }
 }
 
@@ -548,6 +607,37 @@ int StreamPredictor::getChar() {
   return predLine[predIdx++];
 }
 
+int StreamPredictor::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (predIdx >= rowBytes) {
+      if (!getNextLine()) {
+	break;
+      }
+    }
+    m = rowBytes - predIdx;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, predLine + predIdx, m);
+    predIdx += m;
+    n += m;
+  }
+  return n;
+}
+
+int StreamPredictor::lookSpan(Guchar **span) {
+  if (predIdx >= rowBytes) {
+    if (!getNextLine()) {
+      return 0;
+    }
+  }
+  *span = predLine + predIdx;
+  return rowBytes - predIdx;
+}
+
 GBool StreamPredictor::getNextLine() {
   int curPred;
   Guchar upLeftBuf[gfxColorMaxComps * 2 + 1];
@@ -723,6 +813,47 @@ void FileStream::close() {
   }
 }
 
+int FileStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (bufPtr >= bufEnd) {
+      // read big blocks straight into the caller's buffer
+      if (nChars - n >= fileStreamBufSize) {
+	bufPos += bufEnd - buf;
+	bufPtr = bufEnd = buf;
+	m = nChars - n;
+	if (limited) {
+	  if (bufPos >= start + length) {
+	    break;
+	  }
+	  if (bufPos + m > start + length) {
+	    m = start + length - bufPos;
+	  }
+	}
+	if ((m = fread(buffer + n, 1, m, f)) <= 0) {
+	  break;
+	}
+	bufPos += m;
+	n += m;
+	continue;
+      }
+      if (!fillBuf()) {
+	break;
+      }
+    }
+    m = bufEnd - bufPtr;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 GBool FileStream::fillBuf() {
   int n;
 
@@ -808,12 +939,11 @@ HttpStream::HttpStream(CurlCache *ccA, Guint startA, GBool limitedA,
   length = lengthA;
   bufPtr = bufEnd = buf;
   bufPos = start;
-  savePos = 0;
-  saved = gFalse;
+  nextPos = readAheadEnd = 0;
+  readAheadSize = httpStreamMinReadAhead;
 }
 
 HttpStream::~HttpStream() {
-  close();
 }
 
 Stream *HttpStream::makeSubStream(Guint startA, GBool limitedA,
@@ -822,22 +952,31 @@ Stream *HttpStream::makeSubStream(Guint startA, GBool limitedA,
 }
 
 void HttpStream::reset() {
-  savePos = (Guint)cc->tell();
-  cc->seek(start, SEEK_SET);
-  
-  saved = gTrue;
   bufPtr = bufEnd = buf;
   bufPos = start;
 }
 
-void HttpStream::close() {
-  if (saved) {
-    cc->seek(savePos, SEEK_SET);
-    saved = gFalse;
+int HttpStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      break;
+    }
+    m = bufEnd - bufPtr;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
   }
+  return n;
 }
 
 GBool HttpStream::fillBuf() {
+  Guint end;
   int n;
 
   bufPos += bufEnd - buf;
@@ -850,7 +989,33 @@ GBool HttpStream::fillBuf() {
   } else {
     n = httpStreamBufSize;
   }
-  cc->read(buf, 1, n);
+
+  // a stream that is read front to back gets an exponentially growing
+  // read-ahead, so decoding it isn't held up by a round trip per chunk
+  if (bufPos == nextPos) {
+    if (bufPos + readAheadSize / 2 >= readAheadEnd) {
+      if (readAheadEnd < bufPos) {
+	readAheadEnd = bufPos;
+      }
+      end = bufPos + readAheadSize;
+      if (limited && end > start + length) {
+	end = start + length;
+      }
+      if (end > readAheadEnd) {
+	cc->preload(readAheadEnd, end);
+	readAheadEnd = end;
+      }
+      if (readAheadSize < httpStreamMaxReadAhead) {
+	readAheadSize *= 2;
+      }
+    }
+  } else {
+    readAheadSize = httpStreamMinReadAhead;
+    readAheadEnd = bufPos;
+  }
+
+  n = cc->readAt(bufPos, buf, n);
+  nextPos = bufPos + n;
   bufEnd = buf + n;
   if (bufPtr >= bufEnd) {
     return gFalse;
@@ -862,19 +1027,14 @@ void HttpStream::setPos(Guint pos, int dir) {
   Guint size;
 
   if (dir >= 0) {
-    cc->seek(pos, SEEK_SET);
     bufPos = pos;
   } else {
-    cc->seek(0, SEEK_END);
-    size = (Guint)cc->tell();
-    
+    size = (Guint)cc->getLength();
     if (pos > size)
-      pos = (Guint)size;
-    
-    cc->seek(-(int)pos, SEEK_END);
-    bufPos = (Guint)cc->tell();
+      pos = size;
+    bufPos = size - pos;
   }
-  
+
   bufPtr = bufEnd = buf;
 }
 
@@ -888,6 +1048,38 @@ void HttpStream::preload(Guint from, Guint to) {
   cc->preload(from, to);
 }
 
+void HttpStream::preload(int nRanges, Guint *from, Guint *to) {
+  size_t *starts, *ends;
+  int i;
+
+  starts = (size_t *)gmallocn(nRanges, sizeof(size_t));
+  ends = (size_t *)gmallocn(nRanges, sizeof(size_t));
+  for (i = 0; i < nRanges; ++i) {
+    starts[i] = from[i];
+    ends[i] = to[i];
+  }
+  cc->preload(nRanges, starts, ends);
+  gfree(starts);
+  gfree(ends);
+}
+
+void HttpStream::pin(Guint from, Guint to) {
+  cc->pin(from, to);
+}
+
+void HttpStream::unpin(Guint from, Guint to) {
+  cc->unpin(from, to);
+}
+
+int HttpStream::getMisses() {
+  return cc->getMisses();
+}
+
+GBool HttpStream::getNetStats(NetStats *stats) {
+  cc->getStats(stats);
+  return gTrue;
+}
+
 #endif
 
 //------------------------------------------------------------------------
@@ -928,6 +1120,18 @@ void MemStream::reset() {
   bufPtr = buf + start;
 }
 
+int MemStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
+  n = (int)(bufEnd - bufPtr);
+  if (n > nChars) {
+    n = nChars;
+  }
+  memcpy(buffer, bufPtr, n);
+  bufPtr += n;
+  return n;
+}
+
 void MemStream::close() {
 }
 
@@ -989,6 +1193,27 @@ int EmbedStream::lookChar() {
   return str->lookChar();
 }
 
+int EmbedStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
+  if (limited && (Guint)nChars > length) {
+    nChars = (int)length;
+  }
+  n = str->getChars(nChars, buffer);
+  length -= n;
+  return n;
+}
+
+int EmbedStream::lookSpan(Guchar **span) {
+  int n;
+
+  n = str->lookSpan(span);
+  if (limited && n > 0 && (Guint)n > length) {
+    n = (int)length;
+  }
+  return n;
+}
+
 void EmbedStream::setPos(Guint pos, int dir) {
   error(-1, "Internal: called setPos() on EmbedStream");
 }
@@ -1075,6 +1300,19 @@ int ASCIIHexStream::lookChar() {
   return buf;
 }
 
+int ASCIIHexStream::getChars(int nChars, Guchar *buffer) {
+  int n, c;
+
+  for (n = 0; n < nChars; ++n) {
+    if ((c = ASCIIHexStream::lookChar()) == EOF) {
+      break;
+    }
+    buffer[n] = (Guchar)c;
+    buf = EOF;
+  }
+  return n;
+}
+
 GooString *ASCIIHexStream::getPSFilter(int psLevel, char *indent) {
   GooString *s;
 
@@ -1156,6 +1394,19 @@ int ASCII85Stream::lookChar() {
   return b[index];
 }
 
+int ASCII85Stream::getChars(int nChars, Guchar *buffer) {
+  int i, ch;
+
+  for (i = 0; i < nChars; ++i) {
+    if ((ch = ASCII85Stream::lookChar()) == EOF) {
+      break;
+    }
+    buffer[i] = (Guchar)ch;
+    ++index;
+  }
+  return i;
+}
+
 GooString *ASCII85Stream::getPSFilter(int psLevel, char *indent) {
   GooString *s;
 
@@ -1232,6 +1483,54 @@ int LZWStream::lookChar() {
   return seqBuf[seqIndex];
 }
 
+int LZWStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  if (pred) {
+    return pred->getChars(nChars, buffer);
+  }
+  n = 0;
+  while (n < nChars && !eof) {
+    if (seqIndex >= seqLength) {
+      if (!processNextCode()) {
+	break;
+      }
+    }
+    m = seqLength - seqIndex;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, seqBuf + seqIndex, m);
+    seqIndex += m;
+    n += m;
+  }
+  return n;
+}
+
+int LZWStream::lookSpan(Guchar **span) {
+  if (pred) {
+    return pred->lookSpan(span);
+  }
+  if (eof) {
+    return 0;
+  }
+  if (seqIndex >= seqLength) {
+    if (!processNextCode()) {
+      return 0;
+    }
+  }
+  *span = seqBuf + seqIndex;
+  return seqLength - seqIndex;
+}
+
+void LZWStream::skipSpan(int n) {
+  if (pred) {
+    pred->skipSpan(n);
+  } else {
+    seqIndex += n;
+  }
+}
+
 int LZWStream::getRawChar() {
   if (eof) {
     return EOF;
@@ -1400,6 +1699,25 @@ GBool RunLengthStream::isBinary(GBool last) {
   return str->isBinary(gTrue);
 }
 
+int RunLengthStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      break;
+    }
+    m = bufEnd - bufPtr;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 GBool RunLengthStream::fillBuf() {
   int c;
   int n, i;
@@ -4257,6 +4575,63 @@ int FlateStream::lookChar() {
   return c;
 }
 
+int FlateStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  if (pred) {
+    return pred->getChars(nChars, buffer);
+  }
+  n = 0;
+  while (n < nChars) {
+    while (remain == 0) {
+      if (endOfBlock && eof)
+	return n;
+      readSome();
+    }
+    // the output buffer is a ring, copy up to its end at most
+    m = flateWindow - index;
+    if (m > remain) {
+      m = remain;
+    }
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, buf + index, m);
+    index = (index + m) & flateMask;
+    remain -= m;
+    n += m;
+  }
+  return n;
+}
+
+int FlateStream::lookSpan(Guchar **span) {
+  int n;
+
+  if (pred) {
+    return pred->lookSpan(span);
+  }
+  while (remain == 0) {
+    if (endOfBlock && eof)
+      return 0;
+    readSome();
+  }
+  n = flateWindow - index;
+  if (n > remain) {
+    n = remain;
+  }
+  *span = buf + index;
+  return n;
+}
+
+void FlateStream::skipSpan(int n) {
+  if (pred) {
+    pred->skipSpan(n);
+  } else {
+    index = (index + n) & flateMask;
+    remain -= n;
+  }
+}
+
 int FlateStream::getRawChar() {
   int c;
 
@@ -39,6 +39,7 @@
 #endif
 
 class BaseStream;
+struct NetStats;
 
 //------------------------------------------------------------------------
 
@@ -105,6 +106,19 @@ public:
   // Peek at next char in stream.
   virtual int lookChar() = 0;
 
+  // Read up to <nChars> chars into <buffer>.  Returns the number of
+  // chars read, which is less than <nChars> only at end of stream.
+  virtual int getChars(int nChars, Guchar *buffer);
+
+  // Point <*span> at the decoded chars that follow the current
+  // position, without consuming them, and return their number (0 at
+  // end of stream).  Returns -1 if the stream has no such buffer, in
+  // which case it has to be read with getChar().
+  virtual int lookSpan(Guchar ** /*span*/) { return -1; }
+
+  // Consume the first <n> chars of the span returned by lookSpan().
+  virtual void skipSpan(int /*n*/) {}
+
   // Get next char from stream without using the predictor.
   // This is only used by StreamPredictor.
   virtual int getRawChar();
@@ -244,6 +258,21 @@ public:
   virtual Dict *getDict() { return dict.getDict(); }
   virtual GooString *getFileName() { return NULL; }
   virtual void preload(Guint from, Guint to) {}
+  // Preload [from[i], to[i]) for all i < nRanges.  Remote files request
+  // them together.
+  virtual void preload(int nRanges, Guint *from, Guint *to)
+    { for (int i = 0; i < nRanges; ++i) preload(from[i], to[i]); }
+  // Keep [from, to) in memory until it is unpinned again, or for the
+  // lifetime of the file (remote files only).  Calls nest.
+  virtual void pin(Guint from, Guint to) {}
+  // Undo a pin() call with the same range.
+  virtual void unpin(Guint from, Guint to) {}
+  // Number of reads that ended early because the data was not loaded
+  // yet (remote files in non-blocking mode only).  What was parsed
+  // from such reads must not be kept.
+  virtual int getMisses() { return 0; }
+  // Get the network traffic counters.  Returns false for local files.
+  virtual GBool getNetStats(NetStats *stats) { return gFalse; }
   virtual Guint getLength() { return length; }
 
   // Get/set position of first byte of stream within the file.
@@ -324,6 +353,8 @@ private:
   int nComps;			// components per pixel
   int nBits;			// bits per component
   int nVals;			// components per line
+  int inputLineSize;		// size of inputLine
+  Guchar *inputLine;		// input line buffer
   Guchar *imgLine;		// line buffer
   int imgIdx;			// current index in imgLine
 };
@@ -346,6 +377,9 @@ public:
 
   int lookChar();
   int getChar();
+  int getChars(int nChars, Guchar *buffer);
+  int lookSpan(Guchar **span);
+  void skipSpan(int n) { predIdx += n; }
 
 private:
 
@@ -385,6 +419,11 @@ public:
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   virtual int lookChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int lookSpan(Guchar **span)
+    { if (bufPtr >= bufEnd && !fillBuf()) return 0;
+      *span = (Guchar *)bufPtr; return (int)(bufEnd - bufPtr); }
+  virtual void skipSpan(int n) { bufPtr += n; }
   virtual int getPos() { return bufPos + (bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart() { return start; }
@@ -416,6 +455,11 @@ private:
 
 #define httpStreamBufSize 1024
 
+// Read-ahead window of a sequentially read HttpStream, it doubles with
+// every refill up to the maximum.
+#define httpStreamMinReadAhead (16 * 1024)
+#define httpStreamMaxReadAhead (4 * 1024 * 1024)
+
 class HttpStream: public BaseStream {
 public:
 
@@ -426,16 +470,25 @@ public:
 				Guint lengthA, Object *dictA);
   virtual StreamKind getKind() { return strHttp; }
   virtual void reset();
-  virtual void close();
   virtual int getChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   virtual int lookChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int lookSpan(Guchar **span)
+    { if (bufPtr >= bufEnd && !fillBuf()) return 0;
+      *span = (Guchar *)bufPtr; return (int)(bufEnd - bufPtr); }
+  virtual void skipSpan(int n) { bufPtr += n; }
   virtual int getPos() { return bufPos + (bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart() { return start; }
   virtual void moveStart(int delta);
   virtual void preload(Guint from, Guint to);
+  virtual void preload(int nRanges, Guint *from, Guint *to);
+  virtual void pin(Guint from, Guint to);
+  virtual void unpin(Guint from, Guint to);
+  virtual int getMisses();
+  virtual GBool getNetStats(NetStats *stats);
 
   virtual int getUnfilteredChar () { return getChar(); }
   virtual void unfilteredReset () { reset(); }
@@ -450,9 +503,11 @@ private:
   char buf[httpStreamBufSize];
   char *bufPtr;
   char *bufEnd;
-  Guint bufPos;
-  int savePos;
-  GBool saved;
+  Guint bufPos;			// file offset of buf[0], each stream
+				//   keeps its own position in the cache
+  Guint nextPos;		// file offset following the last fill
+  Guint readAheadEnd;		// data up to here has been requested
+  Guint readAheadSize;		// current read-ahead window
 };
 #endif
 
@@ -474,6 +529,10 @@ public:
     { return (bufPtr < bufEnd) ? (*bufPtr++ & 0xff) : EOF; }
   virtual int lookChar()
     { return (bufPtr < bufEnd) ? (*bufPtr & 0xff) : EOF; }
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int lookSpan(Guchar **span)
+    { *span = (Guchar *)bufPtr; return (int)(bufEnd - bufPtr); }
+  virtual void skipSpan(int n) { bufPtr += n; }
   virtual int getPos() { return (int)(bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart() { return start; }
@@ -516,6 +575,9 @@ public:
   virtual void reset() {}
   virtual int getChar();
   virtual int lookChar();
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int lookSpan(Guchar **span);
+  virtual void skipSpan(int n) { str->skipSpan(n); length -= n; }
   virtual int getPos() { return str->getPos(); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart();
@@ -545,6 +607,7 @@ public:
   virtual int getChar()
     { int c = lookChar(); buf = EOF; return c; }
   virtual int lookChar();
+  virtual int getChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -568,6 +631,7 @@ public:
   virtual int getChar()
     { int ch = lookChar(); ++index; return ch; }
   virtual int lookChar();
+  virtual int getChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -593,6 +657,9 @@ public:
   virtual void reset();
   virtual int getChar();
   virtual int lookChar();
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int lookSpan(Guchar **span);
+  virtual void skipSpan(int n);
   virtual int getRawChar();
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
@@ -638,6 +705,11 @@ public:
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   virtual int lookChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int lookSpan(Guchar **span)
+    { if (bufPtr >= bufEnd && !fillBuf()) return 0;
+      *span = (Guchar *)bufPtr; return (int)(bufEnd - bufPtr); }
+  virtual void skipSpan(int n) { bufPtr += n; }
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -852,6 +924,9 @@ public:
   virtual void reset();
   virtual int getChar();
   virtual int lookChar();
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int lookSpan(Guchar **span);
+  virtual void skipSpan(int n);
   virtual int getRawChar();
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
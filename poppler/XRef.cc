@@ -37,6 +37,7 @@
 #include <ctype.h>
 #include <limits.h>
 #include "goo/gmem.h"
+#include "goo/GooList.h"
 #include "Object.h"
 #include "Stream.h"
 #include "Lexer.h"
@@ -44,6 +45,8 @@
 #include "Dict.h"
 #include "Error.h"
 #include "ErrorCodes.h"
+#include "GlobalParams.h"
+#include "PopplerCache.h"
 #include "XRef.h"
 
 //------------------------------------------------------------------------
@@ -51,6 +54,38 @@
 #define xrefSearchSize 1024	// read this many bytes at end of file
 				//   to look for 'startxref'
 
+#define xrefSectionPreloadSize 16384	// preload this much of an xref
+					//   section before it is parsed
+#define xrefMaxChainPreload (256*1024)	// read at most this much ahead
+					//   along a /Prev chain
+
+#define xrefDefaultObjectRange 16384	// preload this much of an object
+					//   with no known end
+#define xrefMaxObjectRange (1024*1024)	// larger gaps to the next object
+					//   are not preloaded in full
+
+#define xrefConstructTailSize 16384	// look for the trailer this far from
+					//   the end before reconstructing
+					//   the xref of a remote file
+#define xrefConstructCheckSize 65536	// check whether the page tree is
+					//   complete after scanning this
+					//   much, then twice as much
+
+static int cmpOffsets(const void *p1, const void *p2) {
+  Guint o1 = *(const Guint *)p1;
+  Guint o2 = *(const Guint *)p2;
+
+  if (o1 < o2) {
+    return -1;
+  }
+  return o1 > o2 ? 1 : 0;
+}
+
+// Ranges are pairs of offsets, sorted by their start.
+static int cmpRanges(const void *p1, const void *p2) {
+  return cmpOffsets(p1, p2);
+}
+
 //------------------------------------------------------------------------
 // Permission bits
 // Note that the PDF spec uses 1 base (eg bit 3 is 1<<2)
@@ -84,6 +119,9 @@ public:
   // Return the object number of this object stream.
   int getObjStrNum() { return objStrNum; }
 
+  // Approximate memory taken by the decoded objects, in bytes.
+  Guint getSize() { return dataSize; }
+
   // Get the <objIdx>th object from this stream, which should be
   // object number <objNum>, generation 0.
   Object *getObject(int objIdx, int objNum, Object *obj);
@@ -94,26 +132,40 @@ private:
   int nObjects;			// number of objects in the stream
   Object *objs;			// the objects (length = nObjects)
   int *objNums;			// the object numbers (length = nObjects)
+  Guint dataSize;		// decoded length of the stream
+  BaseStream *pinStr;		// file stream in which [pinStart, pinEnd)
+  Guint pinStart, pinEnd;	//   is pinned while this object is alive
   GBool ok;
 };
 
 ObjectStream::ObjectStream(XRef *xref, int objStrNumA) {
   Stream *str;
+  BaseStream *bs;
   Parser *parser;
   int *offsets;
   Object objStr, obj1, obj2;
   int first, i;
 
   objStrNum = objStrNumA;
+  dataSize = 0;
   nObjects = 0;
   objs = NULL;
   objNums = NULL;
+  pinStr = NULL;
   ok = gFalse;
 
   if (!xref->fetch(objStrNum, 0, &objStr)->isStream()) {
     goto err1;
   }
 
+  // keep the data of remote files around while the decoded objects are
+  // cached -- the destructor unpins it again
+  bs = objStr.getStream()->getBaseStream();
+  pinStr = xref->getBaseStream();
+  pinStart = bs->getStart();
+  pinEnd = bs->getStart() + bs->getLength();
+  pinStr->pin(pinStart, pinEnd);
+
   if (!objStr.streamGetDict()->lookup("N", &obj1)->isInt()) {
     obj1.free();
     goto err1;
@@ -196,6 +248,10 @@ ObjectStream::ObjectStream(XRef *xref, int objStrNumA) {
     delete parser;
   }
 
+  // the last object is assumed to be of average size
+  dataSize = first + offsets[nObjects - 1] +
+             offsets[nObjects - 1] / nObjects +
+             nObjects * sizeof(Object);
   gfree(offsets);
   ok = gTrue;
 
@@ -213,6 +269,9 @@ ObjectStream::~ObjectStream() {
     delete[] objs;
   }
   gfree(objNums);
+  if (pinStr) {
+    pinStr->unpin(pinStart, pinEnd);
+  }
 }
 
 Object *ObjectStream::getObject(int objIdx, int objNum, Object *obj) {
@@ -233,12 +292,22 @@ XRef::XRef() {
   size = 0;
   streamEnds = NULL;
   streamEndsLen = 0;
-  objStr = NULL;
+  objStrs = new GooList();
+  objStrsSize = 0;
+  objStrHits = objStrDecodes = 0;
+  sortedOffsets = NULL;
+  nSortedOffsets = 0;
+  xrefPending = gFalse;
+  xrefChainDepth = 0;
+  constructPending = gFalse;
+  streamEndsSize = 0;
+  objCache = NULL;
 }
 
-XRef::XRef(BaseStream *strA) {
+XRef::XRef(BaseStream *strA, Guint firstPageXRefPos) {
   Guint pos;
   Object obj;
+  int misses, newSize, i;
 
   ok = gTrue;
   errCode = errNone;
@@ -246,20 +315,86 @@ XRef::XRef(BaseStream *strA) {
   entries = NULL;
   streamEnds = NULL;
   streamEndsLen = 0;
-  objStr = NULL;
+  objStrs = new GooList();
+  objStrsSize = 0;
+  objStrHits = objStrDecodes = 0;
+  sortedOffsets = NULL;
+  nSortedOffsets = 0;
+  xrefPending = gFalse;
+  pendingXRefPos = 0;
+  xrefChainDepth = 0;
+  constructPending = gFalse;
+  streamEndsSize = 0;
+  objCache = NULL;
+  if (globalParams && globalParams->getObjectCacheSize() > 0) {
+    objCache = new PopplerObjectCache(globalParams->getObjectCacheSize(),
+				      this);
+  }
 
   encrypted = gFalse;
   permFlags = defPermFlags;
   ownerPasswordOk = gFalse;
 
-  // read the trailer
   str = strA;
   start = str->getStart();
+
+  // in a linearized file the first-page section is enough to get
+  // started, the sections it points to are read on demand
+  if (firstPageXRefPos) {
+    pos = lastXRefPos = firstPageXRefPos;
+    if (readXRef(&pos)) {
+      xrefPending = gTrue;
+      pendingXRefPos = pos;
+    }
+    if (ok && xrefPending) {
+      // make room for all objects up front, so that the number of
+      // objects does not change when the other sections are read
+      trailerDict.dictLookupNF("Size", &obj);
+      if (obj.isInt() && obj.getInt() > size &&
+	  obj.getInt() < INT_MAX / (int)sizeof(XRefEntry)) {
+	newSize = obj.getInt();
+	entries = (XRefEntry *)greallocn(entries, newSize, sizeof(XRefEntry));
+	for (i = size; i < newSize; ++i) {
+	  entries[i].offset = 0xffffffff;
+	  entries[i].type = xrefEntryFree;
+	  entries[i].obj.initNull ();
+	  entries[i].updated = false;
+	  entries[i].gen = 0;
+	}
+	size = newSize;
+      }
+      obj.free();
+    }
+    if (ok) {
+      trailerDict.dictLookupNF("Root", &obj);
+      if (obj.isRef()) {
+	rootNum = obj.getRefNum();
+	rootGen = obj.getRefGen();
+	obj.free();
+	trailerDict.getDict()->setXRef(this);
+	return;
+      }
+      obj.free();
+    }
+
+    // start over the usual way
+    ok = gTrue;
+    xrefPending = gFalse;
+    trailerDict.free();
+  }
+
+  // read the trailer
+  misses = str->getMisses();
   pos = getStartXref();
 
   // if there was a problem with the 'startxref' position, try to
   // reconstruct the xref table
   if (pos == 0) {
+    if (str->getMisses() != misses) {
+      ok = gFalse;
+      errCode = errDamaged;
+      return;
+    }
     if (!(ok = constructXRef())) {
       errCode = errDamaged;
       return;
@@ -270,7 +405,11 @@ XRef::XRef(BaseStream *strA) {
     while (readXRef(&pos)) ;
 
     // if there was a problem with the xref table,
-    // try to reconstruct it
+    // try to reconstruct it, unless the data was just not loaded yet
+    if (!ok && str->getMisses() != misses) {
+      errCode = errDamaged;
+      return;
+    }
     if (!ok) {
       if (!(ok = constructXRef())) {
 	errCode = errDamaged;
@@ -308,9 +447,10 @@ XRef::~XRef() {
   if (streamEnds) {
     gfree(streamEnds);
   }
-  if (objStr) {
-    delete objStr;
-  }
+  clearObjStrs();
+  delete objStrs;
+  gfree(sortedOffsets);
+  delete objCache;
 }
 
 // Read the 'startxref' position.
@@ -344,10 +484,98 @@ Guint XRef::getStartXref() {
   return lastXRefPos;
 }
 
+// Request the sections the trailer dictionary of the section at <pos>
+// points to before they are read.  Incremental updates follow each other
+// in the file, so the earlier sections of a /Prev chain are likely to be
+// found at about the same distance further back: that region is read
+// ahead too, with a window that doubles along the chain.
+void XRef::preloadLinkedSections(Dict *dict, Guint pos) {
+  Object obj;
+  Guint ranges[4], from[2], to[2];
+  Guint prev, span;
+  int n, i;
+
+  n = 0;
+  if (dict->lookupNF("Prev", &obj)->isInt() && obj.getInt() > 0) {
+    prev = (Guint)obj.getInt();
+    ranges[2*n] = prev;
+    if (prev < pos && xrefChainDepth < 16) {
+      span = (pos - prev) << xrefChainDepth;
+      if (span <= xrefMaxChainPreload) {
+	ranges[2*n] = prev > span ? prev - span : 0;
+	++xrefChainDepth;
+      }
+    }
+    ranges[2*n+1] = prev + xrefSectionPreloadSize;
+    ++n;
+  }
+  obj.free();
+  if (dict->lookupNF("XRefStm", &obj)->isInt() && obj.getInt() > 0) {
+    ranges[2*n] = (Guint)obj.getInt();
+    ranges[2*n+1] = ranges[2*n] + xrefSectionPreloadSize;
+    ++n;
+  }
+  obj.free();
+  if (n == 0) {
+    return;
+  }
+
+  qsort(ranges, n, 2 * sizeof(Guint), &cmpRanges);
+  if (n == 2 && ranges[2] <= ranges[1]) {
+    if (ranges[3] > ranges[1]) {
+      ranges[1] = ranges[3];
+    }
+    n = 1;
+  }
+  for (i = 0; i < n; ++i) {
+    from[i] = start + ranges[2*i];
+    to[i] = start + ranges[2*i+1];
+  }
+  str->preload(n, from, to);
+}
+
+// Read the xref sections that were skipped when the file was opened
+// from the first-page section of a linearized file.
+void XRef::completeXRef() {
+  Guint pos;
+  int misses;
+
+  // the rest of a damaged file that was only scanned up to its page tree
+  if (constructPending) {
+    if (!constructScan(-1, 0, gFalse)) {
+      ok = gFalse;
+      errCode = errDamaged;
+    }
+    return;
+  }
+
+  xrefPending = gFalse;
+  gfree(sortedOffsets);
+  sortedOffsets = NULL;
+  pos = pendingXRefPos;
+  misses = str->getMisses();
+  while (readXRef(&pos)) ;
+  if (!ok && str->getMisses() != misses) {
+    // the sections are not loaded yet, read them again next time
+    ok = gTrue;
+    xrefPending = gTrue;
+    return;
+  }
+  if (!ok) {
+    // the trailer dictionary and the entries found so far are replaced
+    if (!(ok = constructXRef())) {
+      errCode = errDamaged;
+      return;
+    }
+    trailerDict.getDict()->setXRef(this);
+  }
+}
+
 // Read one xref table section.  Also reads the associated trailer
 // dictionary, and returns the prev pointer (if any).
 GBool XRef::readXRef(Guint *pos) {
   Parser *parser;
+  BaseStream *bs;
   Object obj;
   GBool more;
 
@@ -378,6 +606,8 @@ GBool XRef::readXRef(Guint *pos) {
     if (!parser->getObj(&obj)->isStream()) {
       goto err1;
     }
+    bs = obj.getStream()->getBaseStream();
+    bs->pin(bs->getStart(), bs->getStart() + bs->getLength());
     more = readXRefStream(obj.getStream(), pos);
     obj.free();
 
@@ -399,9 +629,10 @@ GBool XRef::readXRefTable(Parser *parser, Guint *pos) {
   XRefEntry entry;
   GBool more;
   Object obj, obj2;
-  Guint pos2;
+  Guint sectionPos, pos2;
   int first, n, newSize, i;
 
+  sectionPos = *pos;
   while (1) {
     parser->getObj(&obj);
     if (obj.isCmd("trailer")) {
@@ -419,12 +650,13 @@ GBool XRef::readXRefTable(Parser *parser, Guint *pos) {
     n = obj.getInt();
     obj.free();
     
-    // preload entire subsection (reduces number of roundtrips for remote files)
-    str->preload(*pos, *pos + n*20);
-    
     if (first < 0 || n < 0 || first + n < 0) {
       goto err1;
     }
+
+    // preload entire subsection (reduces number of roundtrips for remote files)
+    str->preload(*pos, *pos + n*20);
+    str->pin(*pos, *pos + n*20);
     if (first + n > size) {
       for (newSize = size ? 2 * size : 1024;
 	   first + n > newSize && newSize > 0;
@@ -490,6 +722,8 @@ GBool XRef::readXRefTable(Parser *parser, Guint *pos) {
     goto err1;
   }
 
+  preloadLinkedSections(obj.getDict(), sectionPos);
+
   // get the 'Prev' pointer
   obj.getDict()->lookupNF("Prev", &obj2);
   if (obj2.isInt()) {
@@ -580,6 +814,9 @@ GBool XRef::readXRefStream(Stream *xrefStr, Guint *pos) {
   }
   obj.free();
 
+  // the previous section loads while this one is decoded
+  preloadLinkedSections(dict, *pos);
+
   xrefStr->reset();
   dict->lookupNF("Index", &idx);
   if (idx.isArray()) {
@@ -710,34 +947,120 @@ GBool XRef::readXRefStreamSection(Stream *xrefStr, int *w, int first, int n) {
 
 // Attempt to construct an xref table for a damaged file.
 GBool XRef::constructXRef() {
-  Parser *parser;
-  Object newTrailerDict, obj;
+  Object obj;
   char buf[256];
   Guint pos;
-  int num, gen;
-  int newSize;
-  int streamEndsSize;
   char *p;
-  int i;
-  GBool gotRoot;
-  char* token = NULL;
-  bool oneCycle = true;
-  int offset = 0;
+  int newSize, i;
+  GBool stopEarly;
 
   gfree(entries);
   size = 0;
   entries = NULL;
+  gfree(sortedOffsets);
+  sortedOffsets = NULL;
 
   error(-1, "PDF file is damaged - attempting to reconstruct xref table...");
-  gotRoot = gFalse;
+  if (objCache) {
+    objCache->clear();
+  }
+  clearObjStrs();
+  if (!trailerDict.isNone()) {
+    trailerDict.free();
+  }
   streamEndsLen = streamEndsSize = 0;
+  constructTrailerPos = 0;
+  stopEarly = gFalse;
+
+  // a remote file is not scanned further than needed: the last trailer
+  // is looked for near the end first, and if the file has no updates,
+  // the scan stops once the page tree is complete and goes on when an
+  // object that was not seen yet is fetched
+  if (str->getKind() == strHttp) {
+    str->setPos(xrefConstructTailSize, -1);
+    while (1) {
+      pos = str->getPos();
+      if (!str->getLine(buf, 256)) {
+	break;
+      }
+      for (p = buf; *p && Lexer::isSpace(*p & 0xff); ++p) ;
+      if (!strncmp(p, "trailer", 7) && constructTrailer(pos)) {
+	constructTrailerPos = pos;
+      }
+    }
+    if (trailerDict.isDict()) {
+      stopEarly = !trailerDict.dictLookupNF("Prev", &obj)->isInt();
+      obj.free();
+      // make room for all objects, so that the page tree can be read
+      // before all of them were seen
+      if (trailerDict.dictLookupNF("Size", &obj)->isInt() &&
+	  obj.getInt() > 0 &&
+	  obj.getInt() < INT_MAX / (int)sizeof(XRefEntry)) {
+	newSize = obj.getInt();
+	entries = (XRefEntry *)greallocn(entries, newSize, sizeof(XRefEntry));
+	for (i = 0; i < newSize; ++i) {
+	  entries[i].offset = 0xffffffff;
+	  entries[i].type = xrefEntryFree;
+	  entries[i].obj.initNull ();
+	  entries[i].updated = false;
+	  entries[i].gen = 0;
+	}
+	size = newSize;
+      } else {
+	stopEarly = gFalse;
+      }
+      obj.free();
+    }
+  }
 
   str->reset();
+  constructPos = str->getPos();
+  if (!constructScan(-1, 0, stopEarly)) {
+    return gFalse;
+  }
+
+  if (trailerDict.isDict())
+    return gTrue;
+
+  error(-1, "Couldn't find trailer dictionary");
+  return gFalse;
+}
+
+// Scan a damaged file from <constructPos> on for objects, trailers and
+// stream ends.  Stops at the end of the file, once object <stopNum> was
+// found, once a stream end at or after <stopEnd> (if not 0) was found,
+// or, if <stopAtPages> is set, once the page tree can be read.
+// <constructPending> tells whether there is more to scan.
+GBool XRef::constructScan(int stopNum, Guint stopEnd, GBool stopAtPages) {
+  char buf[256];
+  Guint pos, checkPos;
+  int num, gen;
+  int newSize;
+  int misses;
+  Ref ref;
+  char *p;
+  int i;
+  char* token = NULL;
+  bool oneCycle = true;
+  int offset = 0;
+
+  gfree(sortedOffsets);
+  sortedOffsets = NULL;
+  constructPending = gTrue;
+  misses = str->getMisses();
+  checkPos = constructPos + xrefConstructCheckSize;
+
+  str->setPos(constructPos);
   while (1) {
     pos = str->getPos();
     if (!str->getLine(buf, 256)) {
       break;
     }
+    if (str->getMisses() != misses) {
+      // the line is not loaded yet, it is read again next time
+      constructPos = pos;
+      return gTrue;
+    }
     p = buf;
 
     // skip whitespace
@@ -755,29 +1078,12 @@ GBool XRef::constructXRef() {
         offset = token - p;
       }
 
-      // got trailer dictionary
+      // got trailer dictionary - the ones before the trailer found at
+      // the end would be replaced anyway
       if (!strncmp(p, "trailer", 7)) {
-        obj.initNull();
-        parser = new Parser(NULL,
-		 new Lexer(NULL,
-		   str->makeSubStream(pos + 7, gFalse, 0, &obj)),
-		 gFalse);
-        parser->getObj(&newTrailerDict);
-        if (newTrailerDict.isDict()) {
-	  newTrailerDict.dictLookupNF("Root", &obj);
-	  if (obj.isRef()) {
-	    rootNum = obj.getRefNum();
-	    rootGen = obj.getRefGen();
-	    if (!trailerDict.isNone()) {
-	      trailerDict.free();
-	    }
-	    newTrailerDict.copy(&trailerDict);
-	    gotRoot = gTrue;
-	  }
-	  obj.free();
+        if (pos >= constructTrailerPos) {
+	  constructTrailer(pos);
         }
-        newTrailerDict.free();
-        delete parser;
 
       // look for object
       } else if (isdigit(*p)) {
@@ -804,10 +1110,12 @@ GBool XRef::constructXRef() {
 		    newSize = (num + 1 + 255) & ~255;
 		    if (newSize < 0) {
 		      error(-1, "Bad object number");
+		      constructPending = gFalse;
 		      return gFalse;
 		    }
 		    if (newSize >= INT_MAX / (int)sizeof(XRefEntry)) {
 		      error(-1, "Invalid 'obj' parameters.");
+		      constructPending = gFalse;
 		      return gFalse;
 		    }
 		    entries = (XRefEntry *)
@@ -822,6 +1130,13 @@ GBool XRef::constructXRef() {
 		  }
 		  if (entries[num].type == xrefEntryFree ||
 		      gen >= entries[num].gen) {
+		    if (objCache && entries[num].type != xrefEntryFree) {
+		      // a later copy of an object that may have been
+		      // fetched already
+		      ref.num = num;
+		      ref.gen = entries[num].gen;
+		      objCache->remove(ref);
+		    }
 		    entries[num].offset = pos - start;
 		    entries[num].gen = gen;
 		    entries[num].type = xrefEntryUncompressed;
@@ -837,6 +1152,7 @@ GBool XRef::constructXRef() {
 	  streamEndsSize += 64;
           if (streamEndsSize >= INT_MAX / (int)sizeof(int)) {
             error(-1, "Invalid 'endstream' parameter.");
+	    constructPending = gFalse;
             return gFalse;
           }
 	  streamEnds = (Guint *)greallocn(streamEnds,
@@ -853,13 +1169,108 @@ GBool XRef::constructXRef() {
         }
       }
     }
+
+    if ((stopNum >= 0 && stopNum < size &&
+	 entries[stopNum].type != xrefEntryFree) ||
+	(stopEnd > 0 && streamEndsLen > 0 &&
+	 streamEnds[streamEndsLen - 1] >= stopEnd)) {
+      constructPos = str->getPos();
+      return gTrue;
+    }
+    if (stopAtPages && pos >= checkPos) {
+      if (constructPagesFound()) {
+	constructPos = str->getPos();
+	return gTrue;
+      }
+      checkPos = constructPos + 2 * (checkPos - constructPos);
+    }
   }
 
-  if (gotRoot)
-    return gTrue;
+  constructPending = gFalse;
+  return gTrue;
+}
 
-  error(-1, "Couldn't find trailer dictionary");
-  return gFalse;
+// Read the trailer dictionary at <pos> of a damaged file.  It replaces
+// the current one if it points to a catalog.
+GBool XRef::constructTrailer(Guint pos) {
+  Parser *parser;
+  Object newTrailerDict, obj;
+  GBool gotRoot;
+
+  gotRoot = gFalse;
+  obj.initNull();
+  parser = new Parser(NULL,
+	     new Lexer(NULL,
+	       str->makeSubStream(pos + 7, gFalse, 0, &obj)),
+	     gFalse);
+  parser->getObj(&newTrailerDict);
+  if (newTrailerDict.isDict()) {
+    newTrailerDict.dictLookupNF("Root", &obj);
+    if (obj.isRef()) {
+      rootNum = obj.getRefNum();
+      rootGen = obj.getRefGen();
+      if (!trailerDict.isNone()) {
+	trailerDict.free();
+      }
+      newTrailerDict.copy(&trailerDict);
+      gotRoot = gTrue;
+    }
+    obj.free();
+  }
+  newTrailerDict.free();
+  delete parser;
+  return gotRoot;
+}
+
+// Check whether the catalog and all nodes of the page tree can be
+// fetched with the objects the scan has found so far.
+GBool XRef::constructPagesFound() {
+  Object catDict, obj;
+  char *alreadyRead;
+  GBool found;
+
+  // nothing is fetched from the rest of the file meanwhile
+  constructPending = gFalse;
+  found = gFalse;
+  fetch(rootNum, rootGen, &catDict);
+  if (catDict.isDict()) {
+    if (catDict.dictLookupNF("Pages", &obj)->isRef()) {
+      alreadyRead = (char *)gmalloc(size);
+      memset(alreadyRead, 0, size);
+      found = constructPageNodeFound(obj.getRef(), alreadyRead);
+      gfree(alreadyRead);
+    }
+    obj.free();
+  }
+  catDict.free();
+  constructPending = gTrue;
+  return found;
+}
+
+GBool XRef::constructPageNodeFound(Ref ref, char *alreadyRead) {
+  Object node, kids, kid;
+  GBool found;
+  int i;
+
+  if (ref.num < 0 || ref.num >= size || alreadyRead[ref.num]) {
+    return gFalse;
+  }
+  alreadyRead[ref.num] = 1;
+  if (!fetch(ref.num, ref.gen, &node)->isDict()) {
+    node.free();
+    return gFalse;
+  }
+  found = gTrue;
+  if (node.dictLookupNF("Kids", &kids)->isArray()) {
+    for (i = 0; found && i < kids.arrayGetLength(); ++i) {
+      found = kids.arrayGetNF(i, &kid)->isRef() &&
+	      constructPageNodeFound(kid.getRef(), alreadyRead);
+      kid.free();
+    }
+  }
+  kids.free();
+  node.free();
+  return found;
 }
 
 void XRef::setEncryption(int permFlagsA, GBool ownerPasswordOkA,
@@ -882,6 +1293,11 @@ void XRef::setEncryption(int permFlagsA, GBool ownerPasswordOkA,
   encVersion = encVersionA;
   encRevision = encRevisionA;
   encAlgorithm = encAlgorithmA;
+  // anything fetched so far was not decrypted
+  if (objCache) {
+    objCache->clear();
+  }
+  clearObjStrs();
 }
 
 GBool XRef::okToPrint(GBool ignoreOwnerPW) {
@@ -929,7 +1345,24 @@ GBool XRef::okToAssemble(GBool ignoreOwnerPW) {
 Object *XRef::fetch(int num, int gen, Object *obj) {
   XRefEntry *e;
   Parser *parser;
+  ObjectStream *objStr;
   Object obj1, obj2, obj3;
+  Ref ref;
+  int misses;
+
+  // the object may be in a section that has not been read yet
+  if (xrefPending && num >= 0 &&
+      (num >= size || entries[num].offset == 0xffffffff)) {
+    completeXRef();
+  }
+  // or further on in a damaged file that is scanned as needed
+  while (constructPending && num >= 0 &&
+	 (num >= size || entries[num].type == xrefEntryFree)) {
+    misses = str->getMisses();
+    if (!constructScan(num, 0, gFalse) || str->getMisses() != misses) {
+      break;
+    }
+  }
 
   // check for bogus ref - this can happen in corrupted PDF files
   if (num < 0 || num >= size) {
@@ -941,6 +1374,12 @@ Object *XRef::fetch(int num, int gen, Object *obj) {
     obj = e->obj.copy(obj);
     return obj;
   }
+  ref.num = num;
+  ref.gen = gen;
+  if (objCache && !objCache->lookup(ref, obj)->isNull()) {
+    return obj;
+  }
+  misses = str->getMisses();
   switch (e->type) {
 
   case xrefEntryUncompressed:
@@ -1000,18 +1439,14 @@ Object *XRef::fetch(int num, int gen, Object *obj) {
     if (gen != 0) {
       goto err;
     }
-    if (!objStr || objStr->getObjStrNum() != (int)e->offset) {
-      if (objStr) {
-	delete objStr;
-      }
-      objStr = new ObjectStream(this, e->offset);
-      if (!objStr->isOk()) {
-	delete objStr;
-	objStr = NULL;
-	goto err;
-      }
+    if (!(objStr = getObjStr((int)e->offset))) {
+      goto err;
     }
     objStr->getObject(e->gen, num, obj);
+    // an object stream decoded from incomplete data is not kept
+    if (str->getMisses() != misses) {
+      dropObjStr(objStr);
+    }
     break;
 
   default:
@@ -1028,12 +1463,119 @@ Object *XRef::fetch(int num, int gen, Object *obj) {
     obj1.free();
   }
 
+  // streams have a read position of their own, and objects parsed from
+  // data that was not loaded yet are incomplete
+  if (objCache && !obj->isStream() && !obj->isNull() &&
+      str->getMisses() == misses) {
+    objCache->put(ref, obj);
+  }
+
   return obj;
 
  err:
   return obj->initNull();
 }
 
+void XRef::sortOffsets() {
+  int i;
+
+  sortedOffsets = (Guint *)gmallocn(size + 1, sizeof(Guint));
+  nSortedOffsets = 0;
+  for (i = 0; i < size; ++i) {
+    if (entries[i].type == xrefEntryUncompressed &&
+	entries[i].offset != 0xffffffff) {
+      sortedOffsets[nSortedOffsets++] = entries[i].offset;
+    }
+  }
+  // the last object usually ends where the xref table starts
+  sortedOffsets[nSortedOffsets++] = lastXRefPos;
+  qsort(sortedOffsets, nSortedOffsets, sizeof(Guint), &cmpOffsets);
+}
+
+// Byte range from the start of uncompressed object <num> to the next
+// object in the file.
+GBool XRef::getObjectRange(int num, Guint *from, Guint *to) {
+  XRefEntry *e;
+  int a, b, m;
+
+  if (num < 0 || num >= size) {
+    return gFalse;
+  }
+  e = &entries[num];
+  if (e->type != xrefEntryUncompressed || e->offset == 0xffffffff) {
+    return gFalse;
+  }
+  if (!sortedOffsets) {
+    sortOffsets();
+  }
+
+  // find the first offset > e->offset
+  a = -1;
+  b = nSortedOffsets;
+  while (b - a > 1) {
+    m = (a + b) / 2;
+    if (sortedOffsets[m] <= e->offset) {
+      a = m;
+    } else {
+      b = m;
+    }
+  }
+  *from = start + e->offset;
+  if (b < nSortedOffsets &&
+      sortedOffsets[b] - e->offset <= xrefMaxObjectRange) {
+    *to = start + sortedOffsets[b];
+  } else {
+    *to = start + e->offset + xrefDefaultObjectRange;
+  }
+  return gTrue;
+}
+
+void XRef::preloadObjects(int nRefs, Ref *refs) {
+  Guint *ranges;
+  Guint from, to;
+  Guint *starts, *ends;
+  int n, nMerged, num, i;
+
+  if (xrefPending) {
+    completeXRef();
+  }
+  ranges = (Guint *)gmallocn(2 * nRefs, sizeof(Guint));
+  n = 0;
+  for (i = 0; i < nRefs; ++i) {
+    num = refs[i].num;
+    if (num >= 0 && num < size && entries[num].type == xrefEntryCompressed) {
+      num = (int)entries[num].offset;
+    }
+    if (getObjectRange(num, &from, &to)) {
+      ranges[2*n] = from;
+      ranges[2*n+1] = to;
+      ++n;
+    }
+  }
+  qsort(ranges, n, 2 * sizeof(Guint), &cmpRanges);
+
+  starts = (Guint *)gmallocn(n, sizeof(Guint));
+  ends = (Guint *)gmallocn(n, sizeof(Guint));
+  nMerged = 0;
+  for (i = 0; i < n; ++i) {
+    if (nMerged > 0 && ranges[2*i] <= ends[nMerged - 1]) {
+      if (ranges[2*i+1] > ends[nMerged - 1]) {
+	ends[nMerged - 1] = ranges[2*i+1];
+      }
+    } else {
+      starts[nMerged] = ranges[2*i];
+      ends[nMerged] = ranges[2*i+1];
+      ++nMerged;
+    }
+  }
+  if (nMerged > 0) {
+    str->preload(nMerged, starts, ends);
+  }
+  gfree(starts);
+  gfree(ends);
+  gfree(ranges);
+}
+
 Object *XRef::getDocInfo(Object *obj) {
   return trailerDict.dictLookup("Info", obj);
 }
@@ -1043,9 +1585,82 @@ Object *XRef::getDocInfoNF(Object *obj) {
   return trailerDict.dictLookupNF("Info", obj);
 }
 
-GBool XRef::getStreamEnd(Guint streamStart, Guint *streamEnd) {
-  int a, b, m;
+// Return the decoded object stream <objStrNum>, from the cache if
+// possible.  The least recently used ones are dropped once the cache is
+// larger than its budget, but the one returned stays.
+ObjectStream *XRef::getObjStr(int objStrNum) {
+  ObjectStream *objStr;
+  Guint maxSize;
+  int i;
 
+  for (i = 0; i < objStrs->getLength(); ++i) {
+    objStr = (ObjectStream *)objStrs->get(i);
+    if (objStr->getObjStrNum() == objStrNum) {
+      if (i > 0) {
+	objStrs->del(i);
+	objStrs->insert(0, objStr);
+      }
+      ++objStrHits;
+      return objStr;
+    }
+  }
+
+  ++objStrDecodes;
+  objStr = new ObjectStream(this, objStrNum);
+  if (!objStr->isOk()) {
+    delete objStr;
+    return NULL;
+  }
+  objStrs->insert(0, objStr);
+  objStrsSize += objStr->getSize();
+  maxSize = globalParams ? globalParams->getObjectStreamCacheSize() : 0;
+  while (objStrs->getLength() > 1 && objStrsSize > maxSize) {
+    dropObjStr((ObjectStream *)objStrs->get(objStrs->getLength() - 1));
+  }
+  return objStr;
+}
+
+void XRef::dropObjStr(ObjectStream *objStr) {
+  int i;
+
+  for (i = 0; i < objStrs->getLength(); ++i) {
+    if (objStrs->get(i) == objStr) {
+      objStrs->del(i);
+      objStrsSize -= objStr->getSize();
+      delete objStr;
+      return;
+    }
+  }
+}
+
+void XRef::clearObjStrs() {
+  while (objStrs->getLength() > 0) {
+    delete (ObjectStream *)objStrs->del(objStrs->getLength() - 1);
+  }
+  objStrsSize = 0;
+}
+
+int XRef::getObjectCacheHits() {
+  return objCache ? objCache->getHits() : 0;
+}
+
+int XRef::getObjectCacheMisses() {
+  return objCache ? objCache->getMisses() : 0;
+}
+
+GBool XRef::getStreamEnd(Guint streamStart, Guint *streamEnd) {
+  int a, b, m, misses;
+
+  // a damaged file that is scanned as needed is scanned up to the end
+  // of this stream
+  while (constructPending &&
+	 (streamEndsLen == 0 || streamStart > streamEnds[streamEndsLen - 1])) {
+    misses = str->getMisses();
+    if (!constructScan(-1, streamStart, gFalse) ||
+	str->getMisses() != misses) {
+      break;
+    }
+  }
   if (streamEndsLen == 0 ||
       streamStart > streamEnds[streamEndsLen - 1]) {
     return gFalse;
@@ -1066,8 +1681,11 @@ GBool XRef::getStreamEnd(Guint streamStart, Guint *streamEnd) {
   return gTrue;
 }
 
-int XRef::getNumEntry(Guint offset) const
+int XRef::getNumEntry(Guint offset)
 {
+  if (xrefPending || constructPending) {
+    completeXRef();
+  }
   if (size > 0)
   {
     int res = 0;
@@ -1100,6 +1718,11 @@ Guint XRef::strToUnsigned(char *s) {
 }
 
 void XRef::add(int num, int gen, Guint offs, GBool used) {
+  if (xrefPending || constructPending) {
+    completeXRef();
+  }
+  gfree(sortedOffsets);
+  sortedOffsets = NULL;
   if (num >= size) {
     entries = (XRefEntry *)greallocn(entries, num + 1, sizeof(XRefEntry));
     for (int i = size; i < num + 1; ++i) {
@@ -1125,16 +1748,25 @@ void XRef::add(int num, int gen, Guint offs, GBool used) {
 }
 
 void XRef::setModifiedObject (Object* o, Ref r) {
+  if (xrefPending || constructPending) {
+    completeXRef();
+  }
   if (r.num < 0 || r.num >= size) {
     error(-1,"XRef::setModifiedObject on unknown ref: %i, %i\n", r.num, r.gen);
     return;
   }
+  if (objCache) {
+    objCache->remove(r);
+  }
   entries[r.num].obj.free();
   o->copy(&entries[r.num].obj);
   entries[r.num].updated = true;
 }
 
 Ref XRef::addIndirectObject (Object* o) {
+  if (xrefPending || constructPending) {
+    completeXRef();
+  }
   int entryIndexToUse = -1;
   for (int i = 1; entryIndexToUse == -1 && i < size; ++i) {
     if (entries[i].type == xrefEntryFree) entryIndexToUse = i;
@@ -1164,6 +1796,9 @@ Ref XRef::addIndirectObject (Object* o) {
 }
 
 void XRef::writeToFile(OutStream* outStr, GBool writeAllEntries) {
+  if (xrefPending || constructPending) {
+    completeXRef();
+  }
   //create free entries linked-list
   if (entries[0].gen != 65535) {
     error(-1, "XRef::writeToFile, entry 0 of the XRef is invalid (gen != 65535)\n");
@@ -37,6 +37,8 @@ class Dict;
 class Stream;
 class Parser;
 class ObjectStream;
+class PopplerObjectCache;
+class GooList;
 
 //------------------------------------------------------------------------
 // XRef
@@ -61,8 +63,11 @@ public:
 
   // Constructor, create an empty XRef, used for PDF writing
   XRef();
-  // Constructor.  Read xref table from stream.
-  XRef(BaseStream *strA);
+  // Constructor.  Read xref table from stream.  If <firstPageXRefPos>
+  // is given, the file is linearized and only the first-page xref
+  // section at that offset is read now; the remaining sections are
+  // read when an object that is not in it is needed.
+  XRef(BaseStream *strA, Guint firstPageXRefPos = 0);
 
   // Destructor.
   ~XRef();
@@ -102,7 +107,8 @@ public:
   Object *getDocInfo(Object *obj);
   Object *getDocInfoNF(Object *obj);
 
-  // Return the number of objects in the xref table.
+  // Return the number of objects in the xref table.  While sections
+  // are pending this is the number the trailer announces.
   int getNumObjects() { return size; }
 
   // Return the offset of the last xref table.
@@ -112,16 +118,38 @@ public:
   int getRootNum() { return rootNum; }
   int getRootGen() { return rootGen; }
 
+  // Request the data of the <nRefs> objects in <refs> from the input
+  // stream in one batch, without parsing them.  Each object is assumed
+  // to reach up to the next object in the file; compressed objects
+  // load their whole object stream.
+  void preloadObjects(int nRefs, Ref *refs);
+
+  // Lookups of parsed objects that were found in the cache and those
+  // that had to be parsed.
+  int getObjectCacheHits();
+  int getObjectCacheMisses();
+
+  // Compressed objects fetched from an object stream that was decoded
+  // already, and object streams that had to be decoded.
+  int getObjectStreamHits() { return objStrHits; }
+  int getObjectStreamDecodes() { return objStrDecodes; }
+
+  // Get the stream the xref table was read from.
+  BaseStream *getBaseStream() { return str; }
+
   // Get end position for a stream in a damaged file.
   // Returns false if unknown or file is not damaged.
   GBool getStreamEnd(Guint streamStart, Guint *streamEnd);
 
   // Retuns the entry that belongs to the offset
-  int getNumEntry(Guint offset) const;
+  int getNumEntry(Guint offset);
 
   // Direct access.
-  int getSize() { return size; }
-  XRefEntry *getEntry(int i) { return &entries[i]; }
+  int getSize()
+    { if (xrefPending || constructPending) completeXRef(); return size; }
+  XRefEntry *getEntry(int i)
+    { if (xrefPending || constructPending) completeXRef();
+      return &entries[i]; }
   Object *getTrailerDict() { return &trailerDict; }
 
   // Write access
@@ -145,7 +173,12 @@ private:
   Guint *streamEnds;		// 'endstream' positions - only used in
 				//   damaged files
   int streamEndsLen;		// number of valid entries in streamEnds
-  ObjectStream *objStr;		// cached object stream
+  int streamEndsSize;		// allocated size of streamEnds
+  GooList *objStrs;		// decoded object streams, most recently
+				//   used first [ObjectStream]
+  Guint objStrsSize;		// memory they take
+  int objStrHits;		// object streams found in objStrs
+  int objStrDecodes;		// object streams decoded
   GBool encrypted;		// true if file is encrypted
   int encRevision;		
   int encVersion;		// encryption algorithm
@@ -154,13 +187,37 @@ private:
   int permFlags;		// permission bits
   Guchar fileKey[16];		// file decryption key
   GBool ownerPasswordOk;	// true if owner password is correct
+  Guint *sortedOffsets;		// offsets of all uncompressed objects in
+				//   ascending order, NULL until needed
+  int nSortedOffsets;
+  GBool xrefPending;		// true if the section at <pendingXRefPos>
+				//   and its predecessors are not read yet
+  Guint pendingXRefPos;		// next section to read
+  int xrefChainDepth;		// /Prev links followed with read-ahead
+  GBool constructPending;	// true if a damaged file was only scanned
+				//   up to <constructPos>
+  Guint constructPos;		// where the scan goes on
+  Guint constructTrailerPos;	// trailers before this are skipped
+  PopplerObjectCache *objCache;	// recently fetched objects, NULL if
+				//   disabled
 
   Guint getStartXref();
+  void preloadLinkedSections(Dict *dict, Guint pos);
   GBool readXRef(Guint *pos);
   GBool readXRefTable(Parser *parser, Guint *pos);
   GBool readXRefStreamSection(Stream *xrefStr, int *w, int first, int n);
   GBool readXRefStream(Stream *xrefStr, Guint *pos);
+  void completeXRef();
+  ObjectStream *getObjStr(int objStrNum);
+  void dropObjStr(ObjectStream *objStr);
+  void clearObjStrs();
+  void sortOffsets();
+  GBool getObjectRange(int num, Guint *from, Guint *to);
   GBool constructXRef();
+  GBool constructScan(int stopNum, Guint stopEnd, GBool stopAtPages);
+  GBool constructTrailer(Guint pos);
+  GBool constructPagesFound();
+  GBool constructPageNodeFound(Ref ref, char *alreadyRead);
   Guint strToUnsigned(char *s);
 };
 
@@ -0,0 +1,171 @@
+//========================================================================
+//
+// curl-chunk-bench.cc
+//
+// Compares the dense chunk table used by CurlCache with the std::map
+// based index it replaced, on sequential and random read traces.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ENABLE_LIBCURL
+
+#include <map>
+#include "goo/GooTimer.h"
+#include "CurlCache.h"
+
+// The old index: one heap node per chunk, created on first lookup.
+struct MapChunk {
+  CurlCacheChunkState state;
+  int pins;
+  GBool referenced;
+  char data[curlCacheDefaultChunkSize];
+};
+
+struct Read {
+  size_t offset;
+  size_t len;
+};
+
+static char buf[1024 * 1024];
+
+// Replay <reads> the way CurlCache::readAt does: check the state of
+// every chunk in the range, fill the new ones, then copy the data out.
+static double runMap(Read *reads, int nReads) {
+  std::map<unsigned, MapChunk> *chunks;
+  GooTimer timer;
+  int r, i, first, last;
+  size_t offset, n, left;
+
+  timer.start();
+  chunks = new std::map<unsigned, MapChunk>();
+  for (r = 0; r < nReads; ++r) {
+    first = reads[r].offset / curlCacheDefaultChunkSize;
+    last = (reads[r].offset + reads[r].len - 1) / curlCacheDefaultChunkSize;
+    for (i = first; i <= last; ++i) {
+      MapChunk *c = &(*chunks)[i];
+      if (c->state != cccStateLoaded) {
+	memset(c->data, i & 0xff, curlCacheDefaultChunkSize);
+	c->state = cccStateLoaded;
+      }
+    }
+    offset = reads[r].offset;
+    left = reads[r].len;
+    while (left) {
+      i = offset / curlCacheDefaultChunkSize;
+      n = curlCacheDefaultChunkSize - offset % curlCacheDefaultChunkSize;
+      if (n > left) {
+	n = left;
+      }
+      memcpy(buf + (reads[r].len - left),
+	     (*chunks)[i].data + offset % curlCacheDefaultChunkSize, n);
+      (*chunks)[i].referenced = gTrue;
+      offset += n;
+      left -= n;
+    }
+  }
+  delete chunks;
+  timer.stop();
+  return timer.getElapsed();
+}
+
+static double runTable(Read *reads, int nReads, int nChunks) {
+  CurlChunkTable *chunks;
+  GooTimer timer;
+  int r, i, first, last;
+  size_t offset, n, left;
+
+  timer.start();
+  chunks = new CurlChunkTable(nChunks, curlCacheDefaultChunkSize);
+  for (r = 0; r < nReads; ++r) {
+    first = reads[r].offset / curlCacheDefaultChunkSize;
+    last = (reads[r].offset + reads[r].len - 1) / curlCacheDefaultChunkSize;
+    for (i = first; i <= last; ++i) {
+      CurlCacheChunk *c = chunks->get(i);
+      if (c->state != cccStateLoaded) {
+	memset(chunks->getData(i), i & 0xff, curlCacheDefaultChunkSize);
+	c->state = cccStateLoaded;
+      }
+    }
+    offset = reads[r].offset;
+    left = reads[r].len;
+    while (left) {
+      i = offset / curlCacheDefaultChunkSize;
+      n = curlCacheDefaultChunkSize - offset % curlCacheDefaultChunkSize;
+      if (n > left) {
+	n = left;
+      }
+      memcpy(buf + (reads[r].len - left),
+	     chunks->getData(i) + offset % curlCacheDefaultChunkSize, n);
+      chunks->get(i)->referenced = gTrue;
+      offset += n;
+      left -= n;
+    }
+  }
+  delete chunks;
+  timer.stop();
+  return timer.getElapsed();
+}
+
+static void run(const char *name, Read *reads, int nReads, int nChunks) {
+  double tMap, tTable;
+
+  tMap = runMap(reads, nReads);
+  tTable = runTable(reads, nReads, nChunks);
+  printf("%-12s %8d reads  map %8.3f ms  table %8.3f ms  (%.1fx)\n",
+	 name, nReads, tMap * 1000, tTable * 1000,
+	 tTable > 0 ? tMap / tTable : 0.0);
+}
+
+int main(int argc, char *argv[]) {
+  size_t fileSize;
+  int nChunks, nReads, i;
+  Read *reads;
+
+  if (argc > 3) {
+    fprintf(stderr, "usage: curl-chunk-bench [file size in MB] [reads]\n");
+    return 1;
+  }
+  fileSize = (size_t)(argc > 1 ? atoi(argv[1]) : 64) * 1024 * 1024;
+  nReads = argc > 2 ? atoi(argv[2]) : 200000;
+  if (fileSize == 0 || nReads <= 0) {
+    fprintf(stderr, "curl-chunk-bench: bad arguments\n");
+    return 1;
+  }
+  nChunks = (fileSize + curlCacheDefaultChunkSize - 1) / curlCacheDefaultChunkSize;
+  reads = new Read[nReads];
+
+  // HttpStream reads in small pieces front to back
+  for (i = 0; i < nReads; ++i) {
+    reads[i].len = 1024;
+    reads[i].offset = ((size_t)i * reads[i].len) % (fileSize - reads[i].len);
+  }
+  run("sequential", reads, nReads, nChunks);
+
+  // object lookups jump around the file
+  srand(1);
+  for (i = 0; i < nReads; ++i) {
+    reads[i].len = 1 + rand() % (3 * curlCacheDefaultChunkSize);
+    reads[i].offset = ((size_t)rand() * 4099) % (fileSize - reads[i].len);
+  }
+  run("random", reads, nReads, nChunks);
+
+  delete[] reads;
+  return 0;
+}
+
+#else
+
+int main(int argc, char *argv[]) {
+  fprintf(stderr, "curl-chunk-bench: built without libcurl\n");
+  return 1;
+}
+
+#endif
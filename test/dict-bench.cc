@@ -0,0 +1,122 @@
+//========================================================================
+//
+// dict-bench.cc
+//
+// Times Dict lookups against the linear scan Dict used before it got a
+// hash index, for dicts of various sizes, and checks that both find
+// the same entries.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "Object.h"
+#include "Dict.h"
+
+// The old lookup: a reverse strcmp scan, so that the last of several
+// duplicate keys wins.
+static int scanFind(char **keys, int n, char *key) {
+  int i;
+
+  for (i = n - 1; i >= 0; --i) {
+    if (!strcmp(key, keys[i])) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static GBool run(int n, int nLookups) {
+  Dict *dict;
+  Object obj;
+  GooTimer timer;
+  GooString *s;
+  char **keys, **probes;
+  double tScan, tDict;
+  int i, found, sum;
+  GBool ok;
+
+  // keys look like resource names; every fourth probe misses
+  keys = (char **)gmallocn(n, sizeof(char *));
+  probes = (char **)gmallocn(nLookups, sizeof(char *));
+  dict = new Dict((XRef *)NULL);
+  for (i = 0; i < n; ++i) {
+    s = GooString::format("R{0:d}", i);
+    keys[i] = copyString(s->getCString());
+    obj.initInt(i);
+    dict->add(copyString(s->getCString()), &obj);
+    delete s;
+  }
+  srand(n);
+  for (i = 0; i < nLookups; ++i) {
+    probes[i] = (i & 3) == 3 ? (char *)"Missing" : keys[rand() % n];
+  }
+
+  sum = 0;
+  timer.start();
+  for (i = 0; i < nLookups; ++i) {
+    sum += scanFind(keys, n, probes[i]);
+  }
+  timer.stop();
+  tScan = timer.getElapsed();
+
+  found = 0;
+  timer.start();
+  for (i = 0; i < nLookups; ++i) {
+    dict->lookupNF(probes[i], &obj);
+    found += obj.isInt() ? obj.getInt() : -1;
+    obj.free();
+  }
+  timer.stop();
+  tDict = timer.getElapsed();
+
+  // a later duplicate of a key shadows the earlier entry
+  obj.initInt(n);
+  dict->add(copyString(keys[0]), &obj);
+  dict->lookupNF(keys[0], &obj);
+  ok = found == sum && obj.isInt() && obj.getInt() == n;
+  obj.free();
+
+  printf("%6d keys  %8d lookups  scan %8.3f ms  dict %8.3f ms  (%.1fx)  %s\n",
+	 n, nLookups, tScan * 1000, tDict * 1000,
+	 tDict > 0 ? tScan / tDict : 0.0, ok ? "ok" : "MISMATCH");
+
+  delete dict;
+  for (i = 0; i < n; ++i) {
+    gfree(keys[i]);
+  }
+  gfree(keys);
+  gfree(probes);
+  return ok;
+}
+
+int main(int argc, char *argv[]) {
+  static int sizes[] = { 4, 16, 17, 64, 256, 1024, 8192 };
+  int nLookups, i;
+  GBool ok;
+
+  if (argc > 2) {
+    fprintf(stderr, "usage: dict-bench [lookups]\n");
+    return 1;
+  }
+  nLookups = argc > 1 ? atoi(argv[1]) : 200000;
+  if (nLookups <= 0) {
+    fprintf(stderr, "dict-bench: bad arguments\n");
+    return 1;
+  }
+  ok = gTrue;
+  for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); ++i) {
+    if (!run(sizes[i], nLookups)) {
+      ok = gFalse;
+    }
+  }
+  return ok ? 0 : 1;
+}
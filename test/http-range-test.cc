@@ -0,0 +1,223 @@
+//========================================================================
+//
+// http-range-test.cc
+//
+// Reads a generated file through CurlCache and HttpStream from the
+// loopback test server, in each of its modes, and checks the data.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef ENABLE_LIBCURL
+
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
+#include "CurlCache.h"
+#include "http-test-server.h"
+
+// Size of the generated file; deliberately not a multiple of the chunk
+// size.
+#define testFileSize (3 * 1024 * 1024 + 12345)
+
+#define testRandomReads 200
+#define testMaxReadLen 65536
+#define testPreloadRanges 16
+
+static const char *modeNames[] = { "multi", "single", "full" };
+
+static char *data;
+
+static GBool check(GBool ok, const char *what, const char *test) {
+  if (!ok) {
+    fprintf(stderr, "%s: %s failed\n", test, what);
+  }
+  return ok;
+}
+
+static GBool runTest(HttpTestServer *server, const char *name,
+		     HttpTestServerMode mode, GBool head, const char *test) {
+  CurlCache *cc;
+  HttpStream *str;
+  Object obj;
+  GooTimer timer;
+  size_t starts[testPreloadRanges], ends[testPreloadRanges];
+  char *buf;
+  size_t offset, len, n;
+  GBool ok;
+  int i, c;
+
+  server->setMode(mode);
+  server->setHeadAllowed(head);
+  server->resetStats();
+  buf = (char *)gmalloc(testMaxReadLen);
+  ok = gTrue;
+
+  timer.start();
+  cc = new CurlCache(server->getURL(name));
+  ok = check(cc->getLength() == testFileSize, "size", test);
+
+  // scattered reads
+  srand(1);
+  for (i = 0; ok && i < testRandomReads; ++i) {
+    offset = (size_t)rand() % testFileSize;
+    len = 1 + (size_t)rand() % testMaxReadLen;
+    n = cc->readAt(offset, buf, len);
+    if (offset + len > testFileSize) {
+      len = testFileSize - offset;
+    }
+    ok = check(n == len && !memcmp(buf, data + offset, len),
+	       "readAt", test);
+  }
+
+  // ranges requested together
+  for (i = 0; i < testPreloadRanges; ++i) {
+    starts[i] = (size_t)i * (testFileSize / testPreloadRanges) + 1000;
+    ends[i] = starts[i] + 5000;
+  }
+  cc->preload(testPreloadRanges, starts, ends);
+  for (i = 0; ok && i < testPreloadRanges; ++i) {
+    n = cc->readAt(starts[i], buf, ends[i] - starts[i]);
+    ok = check(n == ends[i] - starts[i] &&
+	       !memcmp(buf, data + starts[i], n), "preload", test);
+  }
+
+  // the whole file through a stream
+  obj.initNull();
+  str = new HttpStream(cc, 0, gFalse, 0, &obj);
+  str->reset();
+  for (offset = 0; ok && (c = str->getChar()) != EOF; ++offset) {
+    ok = check(offset < testFileSize && c == (data[offset] & 0xff),
+	       "stream", test);
+  }
+  ok = ok && check(offset == testFileSize, "stream length", test);
+  str->setPos(4096, -1);
+  ok = ok && check(str->getChar() == (data[testFileSize - 4096] & 0xff),
+		   "setPos from end", test);
+  delete str;
+  delete cc;
+  timer.stop();
+  gfree(buf);
+
+  printf("%-14s %s  %4d requests  %4d connections  %9lu bytes  %.3f s\n",
+	 test, ok ? "ok    " : "FAILED", server->getRequests(),
+	 server->getConnections(), (unsigned long)server->getBytesSent(),
+	 timer.getElapsed());
+  return ok;
+}
+
+static void usage() {
+  fprintf(stderr,
+	  "Usage: http-range-test [-mode multi|single|full] [-nohead]\n"
+	  "                       [-latency ms] [-bandwidth bytes/s]\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  HttpTestServer *server;
+  GooString *dir, *fileName, *test;
+  FILE *f;
+  char tmpl[] = "/tmp/http-range-testXXXXXX";
+  int modes[3], nModes, latency, bandwidth, failed, i, j;
+  GBool noHead;
+
+  nModes = 0;
+  noHead = gFalse;
+  latency = bandwidth = 0;
+  for (i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-mode") && i + 1 < argc) {
+      ++i;
+      for (j = 0; j < 3; ++j) {
+	if (!strcmp(argv[i], modeNames[j])) {
+	  break;
+	}
+      }
+      if (j == 3 || nModes == 3) {
+	usage();
+      }
+      modes[nModes++] = j;
+    } else if (!strcmp(argv[i], "-nohead")) {
+      noHead = gTrue;
+    } else if (!strcmp(argv[i], "-latency") && i + 1 < argc) {
+      latency = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-bandwidth") && i + 1 < argc) {
+      bandwidth = atoi(argv[++i]);
+    } else {
+      usage();
+    }
+  }
+  if (nModes == 0) {
+    modes[nModes++] = httpTestMultiRange;
+    modes[nModes++] = httpTestSingleRange;
+    modes[nModes++] = httpTestFull;
+  }
+
+  if (!mkdtemp(tmpl)) {
+    fprintf(stderr, "Couldn't create a temporary directory\n");
+    return 1;
+  }
+  dir = new GooString(tmpl);
+  fileName = dir->copy()->append("/data.bin");
+  data = (char *)gmalloc(testFileSize);
+  srand(42);
+  for (i = 0; i < testFileSize; ++i) {
+    data[i] = (char)(rand() >> 4);
+  }
+  if (!(f = fopen(fileName->getCString(), "wb")) ||
+      fwrite(data, 1, testFileSize, f) != testFileSize) {
+    fprintf(stderr, "Couldn't write %s\n", fileName->getCString());
+    return 1;
+  }
+  fclose(f);
+
+  globalParams = new GlobalParams();
+  server = new HttpTestServer(dir->copy());
+  server->setLatency(latency);
+  server->setBandwidth(bandwidth);
+  if (!server->start()) {
+    fprintf(stderr, "Couldn't start the test server\n");
+    return 1;
+  }
+
+  failed = 0;
+  for (i = 0; i < nModes; ++i) {
+    for (j = noHead ? 1 : 0; j < 2; ++j) {
+      test = GooString::format("{0:s}{1:s}", modeNames[modes[i]],
+			       j ? "/nohead" : "");
+      if (!runTest(server, "/data.bin", (HttpTestServerMode)modes[i], !j,
+		   test->getCString())) {
+	++failed;
+      }
+      delete test;
+    }
+  }
+
+  delete server;
+  delete globalParams;
+  unlink(fileName->getCString());
+  rmdir(dir->getCString());
+  delete fileName;
+  delete dir;
+  gfree(data);
+  return failed ? 1 : 0;
+}
+
+#else
+
+int main(int argc, char *argv[]) {
+  fprintf(stderr, "http-range-test needs libcurl\n");
+  return 0;
+}
+
+#endif
@@ -0,0 +1,655 @@
+//========================================================================
+//
+// http-test-server.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "http-test-server.h"
+
+//------------------------------------------------------------------------
+
+// How often the threads check whether the server is stopping
+// (microseconds).
+#define httpTestPollInterval 100000
+
+// Largest request head that is accepted.
+#define httpTestMaxRequest 16384
+
+// Maximum number of ranges in one request.
+#define httpTestMaxRanges 256
+
+// Boundary between the parts of a multipart/byteranges response.
+#define httpTestBoundary "poppler-http-test-boundary"
+
+struct HttpTestConnection {
+  HttpTestServer *server;
+  int fd;
+};
+
+//------------------------------------------------------------------------
+
+// Find header <name> in <request> and return its value, or NULL.  The
+// caller deletes the string.
+static GooString *getHeader(GooString *request, const char *name) {
+  char *p, *end;
+  int n;
+
+  n = strlen(name);
+  p = request->getCString();
+  while ((p = strstr(p, "\r\n"))) {
+    p += 2;
+    if (!strncasecmp(p, name, n) && p[n] == ':') {
+      p += n + 1;
+      while (*p == ' ' || *p == '\t') {
+	++p;
+      }
+      if (!(end = strstr(p, "\r\n"))) {
+	end = p + strlen(p);
+      }
+      return new GooString(p, end - p);
+    }
+  }
+  return NULL;
+}
+
+// Parse a "bytes=..." Range header for a file of <size> bytes.  Ranges
+// that start after the end of the file are dropped.  Returns the number
+// of ranges, or -1 if the header can't be parsed.
+static int parseRanges(GooString *range, size_t size,
+		       size_t *starts, size_t *ends) {
+  char *p, *q;
+  unsigned long a, b;
+  int n;
+
+  p = range->getCString();
+  if (strncmp(p, "bytes=", 6)) {
+    return -1;
+  }
+  p += 6;
+  n = 0;
+  while (*p) {
+    while (*p == ' ') {
+      ++p;
+    }
+    if (*p == '-') {
+      // suffix range
+      b = strtoul(p + 1, &q, 10);
+      if (q == p + 1) {
+	return -1;
+      }
+      a = b < size ? size - b : 0;
+      b = size - 1;
+    } else {
+      a = strtoul(p, &q, 10);
+      if (q == p || *q != '-') {
+	return -1;
+      }
+      p = q + 1;
+      if (*p >= '0' && *p <= '9') {
+	b = strtoul(p, &q, 10);
+      } else {
+	b = size - 1;
+	q = p;
+      }
+      if (b < a) {
+	return -1;
+      }
+    }
+    if (size > 0 && a < size && n < httpTestMaxRanges) {
+      starts[n] = a;
+      ends[n] = b < size ? b + 1 : size;
+      ++n;
+    }
+    p = q;
+    while (*p == ' ') {
+      ++p;
+    }
+    if (*p == ',') {
+      ++p;
+    } else if (*p) {
+      return -1;
+    }
+  }
+  return n;
+}
+
+// Map the request path onto a file below <root>.  Returns NULL for
+// paths that would leave it.
+static GooString *getFilePath(GooString *root, const char *path, int len) {
+  GooString *name;
+  char *p;
+  unsigned int c;
+  int i;
+
+  if (len == 0 || path[0] != '/') {
+    return NULL;
+  }
+  name = root->copy();
+  for (i = 0; i < len && path[i] != '?'; ++i) {
+    c = path[i] & 0xff;
+    if (c == '%' && i + 2 < len) {
+      sscanf(path + i + 1, "%2x", &c);
+      i += 2;
+    }
+    name->append((char)c);
+  }
+  for (p = name->getCString(); (p = strstr(p, "/..")); p += 3) {
+    if (p[3] == '/' || p[3] == '\0') {
+      delete name;
+      return NULL;
+    }
+  }
+  return name;
+}
+
+static const char *getReason(int code) {
+  switch (code) {
+  case 200: return "OK";
+  case 206: return "Partial Content";
+  case 304: return "Not Modified";
+  case 400: return "Bad Request";
+  case 404: return "Not Found";
+  case 405: return "Method Not Allowed";
+  case 416: return "Requested Range Not Satisfiable";
+  default:  return "Error";
+  }
+}
+
+//------------------------------------------------------------------------
+// HttpTestServer
+//------------------------------------------------------------------------
+
+HttpTestServer::HttpTestServer(GooString *rootA) {
+  root = rootA;
+  mode = httpTestMultiRange;
+  headAllowed = gTrue;
+  latency = 0;
+  bandwidth = 0;
+  listenFd = -1;
+  port = 0;
+  running = gFalse;
+  nOpen = 0;
+  requests = connections = 0;
+  bytesSent = 0;
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&idleCond, NULL);
+}
+
+HttpTestServer::~HttpTestServer() {
+  stop();
+  pthread_cond_destroy(&idleCond);
+  pthread_mutex_destroy(&mutex);
+  delete root;
+}
+
+GBool HttpTestServer::start() {
+  struct sockaddr_in addr;
+  socklen_t addrLen;
+  int one;
+
+  if (running) {
+    return gTrue;
+  }
+  if ((listenFd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+    return gFalse;
+  }
+  one = 1;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  addrLen = sizeof(addr);
+  if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listenFd, 64) < 0 ||
+      getsockname(listenFd, (struct sockaddr *)&addr, &addrLen) < 0) {
+    close(listenFd);
+    listenFd = -1;
+    return gFalse;
+  }
+  port = ntohs(addr.sin_port);
+  running = gTrue;
+  if (pthread_create(&thread, NULL, &HttpTestServer::acceptThread, this)) {
+    running = gFalse;
+    close(listenFd);
+    listenFd = -1;
+    return gFalse;
+  }
+  return gTrue;
+}
+
+void HttpTestServer::stop() {
+  if (!running) {
+    return;
+  }
+  pthread_mutex_lock(&mutex);
+  running = gFalse;
+  pthread_mutex_unlock(&mutex);
+  pthread_join(thread, NULL);
+  close(listenFd);
+  listenFd = -1;
+
+  // the connection threads notice within one poll interval
+  pthread_mutex_lock(&mutex);
+  while (nOpen > 0) {
+    pthread_cond_wait(&idleCond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+GooString *HttpTestServer::getURL(const char *path) {
+  GooString *url;
+
+  url = GooString::format("http://127.0.0.1:{0:d}", port);
+  if (*path != '/') {
+    url->append('/');
+  }
+  url->append(path);
+  return url;
+}
+
+int HttpTestServer::getRequests() {
+  int n;
+
+  pthread_mutex_lock(&mutex);
+  n = requests;
+  pthread_mutex_unlock(&mutex);
+  return n;
+}
+
+int HttpTestServer::getConnections() {
+  int n;
+
+  pthread_mutex_lock(&mutex);
+  n = connections;
+  pthread_mutex_unlock(&mutex);
+  return n;
+}
+
+size_t HttpTestServer::getBytesSent() {
+  size_t n;
+
+  pthread_mutex_lock(&mutex);
+  n = bytesSent;
+  pthread_mutex_unlock(&mutex);
+  return n;
+}
+
+void HttpTestServer::resetStats() {
+  pthread_mutex_lock(&mutex);
+  requests = connections = 0;
+  bytesSent = 0;
+  pthread_mutex_unlock(&mutex);
+}
+
+void *HttpTestServer::acceptThread(void *data) {
+  HttpTestServer *server = (HttpTestServer *)data;
+  HttpTestConnection *conn;
+  struct timeval tv;
+  pthread_t connThread;
+  fd_set fds;
+  int fd, one;
+
+  while (1) {
+    pthread_mutex_lock(&server->mutex);
+    if (!server->running) {
+      pthread_mutex_unlock(&server->mutex);
+      break;
+    }
+    pthread_mutex_unlock(&server->mutex);
+
+    FD_ZERO(&fds);
+    FD_SET(server->listenFd, &fds);
+    tv.tv_sec = 0;
+    tv.tv_usec = httpTestPollInterval;
+    if (select(server->listenFd + 1, &fds, NULL, NULL, &tv) <= 0) {
+      continue;
+    }
+    if ((fd = accept(server->listenFd, NULL, NULL)) < 0) {
+      continue;
+    }
+    one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    conn = new HttpTestConnection;
+    conn->server = server;
+    conn->fd = fd;
+    pthread_mutex_lock(&server->mutex);
+    ++server->nOpen;
+    ++server->connections;
+    pthread_mutex_unlock(&server->mutex);
+    if (pthread_create(&connThread, NULL,
+		       &HttpTestServer::connectionThread, conn)) {
+      close(fd);
+      delete conn;
+      pthread_mutex_lock(&server->mutex);
+      --server->nOpen;
+      pthread_cond_broadcast(&server->idleCond);
+      pthread_mutex_unlock(&server->mutex);
+      continue;
+    }
+    pthread_detach(connThread);
+  }
+  return NULL;
+}
+
+void *HttpTestServer::connectionThread(void *data) {
+  HttpTestConnection *conn = (HttpTestConnection *)data;
+  HttpTestServer *server = conn->server;
+
+  server->serveConnection(conn->fd);
+  close(conn->fd);
+  delete conn;
+
+  pthread_mutex_lock(&server->mutex);
+  --server->nOpen;
+  pthread_cond_broadcast(&server->idleCond);
+  pthread_mutex_unlock(&server->mutex);
+  return NULL;
+}
+
+// Read requests from <fd> until the client closes the connection, asks
+// for it to be closed, or the server stops.
+void HttpTestServer::serveConnection(int fd) {
+  GooString *pending, *request;
+  struct timeval tv;
+  fd_set fds;
+  char buf[4096];
+  char *end;
+  GBool stopping;
+  int n;
+
+  pending = new GooString();
+  while (1) {
+    if ((end = strstr(pending->getCString(), "\r\n\r\n"))) {
+      n = end + 4 - pending->getCString();
+      request = new GooString(pending->getCString(), n);
+      pending->del(0, n);
+      if (!handleRequest(fd, request)) {
+	delete request;
+	break;
+      }
+      delete request;
+      continue;
+    }
+    if (pending->getLength() > httpTestMaxRequest) {
+      break;
+    }
+
+    pthread_mutex_lock(&mutex);
+    stopping = !running;
+    pthread_mutex_unlock(&mutex);
+    if (stopping) {
+      break;
+    }
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    tv.tv_sec = 0;
+    tv.tv_usec = httpTestPollInterval;
+    if ((n = select(fd + 1, &fds, NULL, NULL, &tv)) < 0) {
+      break;
+    } else if (n == 0) {
+      continue;
+    }
+    if ((n = recv(fd, buf, sizeof(buf), 0)) <= 0) {
+      break;
+    }
+    pending->append(buf, n);
+  }
+  delete pending;
+}
+
+// Answer one request.  Returns false if the connection is to be closed
+// afterwards.
+GBool HttpTestServer::handleRequest(int fd, GooString *request) {
+  GooString *method, *path, *headers, *etag, *range, *hdr, *connection;
+  size_t starts[httpTestMaxRanges], ends[httpTestMaxRanges];
+  struct stat st;
+  FILE *f;
+  char *p, *q;
+  size_t size, len;
+  GBool keepAlive, head, ok;
+  int nRanges, i;
+
+  pthread_mutex_lock(&mutex);
+  ++requests;
+  pthread_mutex_unlock(&mutex);
+
+  if (latency > 0) {
+    usleep(latency * 1000);
+  }
+
+  // request line
+  p = request->getCString();
+  if (!(q = strchr(p, ' '))) {
+    sendResponse(fd, 400, NULL);
+    return gFalse;
+  }
+  method = new GooString(p, q - p);
+  p = q + 1;
+  if (!(q = strchr(p, ' '))) {
+    delete method;
+    sendResponse(fd, 400, NULL);
+    return gFalse;
+  }
+  path = getFilePath(root, p, q - p);
+
+  keepAlive = !strncmp(q + 1, "HTTP/1.1", 8);
+  if ((connection = getHeader(request, "Connection"))) {
+    if (!strcasecmp(connection->getCString(), "close")) {
+      keepAlive = gFalse;
+    } else if (!strcasecmp(connection->getCString(), "keep-alive")) {
+      keepAlive = gTrue;
+    }
+    delete connection;
+  }
+  head = !method->cmp("HEAD");
+
+  if (method->cmp("GET") && (!head || !headAllowed)) {
+    delete method;
+    delete path;
+    sendResponse(fd, 405, NULL);
+    return keepAlive;
+  }
+  delete method;
+  if (!path || stat(path->getCString(), &st) < 0 || !S_ISREG(st.st_mode) ||
+      !(f = fopen(path->getCString(), "rb"))) {
+    delete path;
+    sendResponse(fd, 404, NULL);
+    return keepAlive;
+  }
+  delete path;
+  size = st.st_size;
+  etag = GooString::format("\"{0:x}-{1:x}\"", (int)size, (int)st.st_mtime);
+
+  headers = new GooString();
+  headers->append("ETag: ")->append(etag)->append("\r\n");
+  if (mode != httpTestFull) {
+    headers->append("Accept-Ranges: bytes\r\n");
+  }
+
+  // a cached copy that is still current
+  if ((hdr = getHeader(request, "If-None-Match"))) {
+    if (!hdr->cmp(etag)) {
+      delete hdr;
+      delete etag;
+      fclose(f);
+      sendResponse(fd, 304, headers);
+      delete headers;
+      return keepAlive;
+    }
+    delete hdr;
+  }
+  delete etag;
+
+  nRanges = 0;
+  range = NULL;
+  if (mode != httpTestFull && !head) {
+    range = getHeader(request, "Range");
+  }
+  if (range) {
+    nRanges = parseRanges(range, size, starts, ends);
+    delete range;
+    if (nRanges == 0) {
+      hdr = GooString::format("Content-Range: bytes */{0:d}\r\n", (int)size);
+      headers->append(hdr);
+      delete hdr;
+      fclose(f);
+      sendResponse(fd, 416, headers);
+      delete headers;
+      return keepAlive;
+    }
+    if (mode == httpTestSingleRange) {
+      nRanges = nRanges > 0 ? 1 : nRanges;
+    }
+  }
+
+  ok = gTrue;
+  if (nRanges <= 0) {
+    // no (usable) Range header: the whole file
+    hdr = GooString::format("Content-Length: {0:d}\r\n", (int)size);
+    headers->append(hdr);
+    delete hdr;
+    sendResponse(fd, 200, headers);
+    if (!head) {
+      ok = sendFileRange(fd, f, 0, size);
+    }
+
+  } else if (nRanges == 1) {
+    hdr = GooString::format("Content-Range: bytes {0:d}-{1:d}/{2:d}\r\n"
+			    "Content-Length: {3:d}\r\n",
+			    (int)starts[0], (int)ends[0] - 1, (int)size,
+			    (int)(ends[0] - starts[0]));
+    headers->append(hdr);
+    delete hdr;
+    sendResponse(fd, 206, headers);
+    ok = sendFileRange(fd, f, starts[0], ends[0]);
+
+  } else {
+    // the part headers go into the Content-Length as well
+    len = 0;
+    for (i = 0; i < nRanges; ++i) {
+      hdr = GooString::format("\r\n--" httpTestBoundary "\r\n"
+			      "Content-Type: application/octet-stream\r\n"
+			      "Content-Range: bytes {0:d}-{1:d}/{2:d}\r\n\r\n",
+			      (int)starts[i], (int)ends[i] - 1, (int)size);
+      len += hdr->getLength() + (ends[i] - starts[i]);
+      delete hdr;
+    }
+    len += strlen("\r\n--" httpTestBoundary "--\r\n");
+    hdr = GooString::format("Content-Type: multipart/byteranges; "
+			    "boundary=" httpTestBoundary "\r\n"
+			    "Content-Length: {0:d}\r\n", (int)len);
+    headers->append(hdr);
+    delete hdr;
+    sendResponse(fd, 206, headers);
+    for (i = 0; ok && i < nRanges; ++i) {
+      hdr = GooString::format("\r\n--" httpTestBoundary "\r\n"
+			      "Content-Type: application/octet-stream\r\n"
+			      "Content-Range: bytes {0:d}-{1:d}/{2:d}\r\n\r\n",
+			      (int)starts[i], (int)ends[i] - 1, (int)size);
+      ok = sendData(fd, hdr->getCString(), hdr->getLength()) &&
+	   sendFileRange(fd, f, starts[i], ends[i]);
+      delete hdr;
+    }
+    if (ok) {
+      ok = sendData(fd, "\r\n--" httpTestBoundary "--\r\n",
+		    strlen("\r\n--" httpTestBoundary "--\r\n"));
+    }
+  }
+  delete headers;
+  fclose(f);
+  return ok && keepAlive;
+}
+
+void HttpTestServer::sendResponse(int fd, int code, GooString *headers) {
+  GooString *s;
+
+  s = GooString::format("HTTP/1.1 {0:d} {1:s}\r\n", code, getReason(code));
+  if (headers) {
+    s->append(headers);
+  }
+  if (code >= 400) {
+    s->append("Content-Length: 0\r\n");
+  }
+  s->append("\r\n");
+  sendData(fd, s->getCString(), s->getLength());
+  delete s;
+}
+
+// Send <len> bytes, no faster than the bandwidth limit.
+GBool HttpTestServer::sendData(int fd, const char *data, size_t len) {
+  size_t slice;
+  ssize_t n;
+
+  while (len > 0) {
+    slice = len;
+    if (bandwidth > 0) {
+      // slices of 10ms
+      slice = bandwidth / 100 > 0 ? bandwidth / 100 : 1;
+      if (slice > len) {
+	slice = len;
+      }
+    }
+    if ((n = send(fd, data, slice, MSG_NOSIGNAL)) < 0) {
+      if (errno == EINTR) {
+	continue;
+      }
+      return gFalse;
+    }
+    data += n;
+    len -= n;
+    if (bandwidth > 0) {
+      usleep((useconds_t)((double)n * 1000000 / bandwidth));
+    }
+  }
+  return gTrue;
+}
+
+GBool HttpTestServer::sendFileRange(int fd, FILE *f, size_t start,
+				    size_t end) {
+  char buf[16384];
+  size_t n;
+
+  if (fseek(f, start, SEEK_SET) < 0) {
+    return gFalse;
+  }
+  while (start < end) {
+    n = end - start < sizeof(buf) ? end - start : sizeof(buf);
+    if ((n = fread(buf, 1, n, f)) == 0) {
+      return gFalse;
+    }
+    if (!sendData(fd, buf, n)) {
+      return gFalse;
+    }
+    countBytes(n);
+    start += n;
+  }
+  return gTrue;
+}
+
+void HttpTestServer::countBytes(size_t n) {
+  pthread_mutex_lock(&mutex);
+  bytesSent += n;
+  pthread_mutex_unlock(&mutex);
+}
@@ -0,0 +1,109 @@
+//========================================================================
+//
+// http-test-server.h
+//
+// A small HTTP/1.1 server on the loopback interface, so that CurlCache
+// and HttpStream can be tested and benchmarked without a real web
+// server.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef HTTP_TEST_SERVER_H
+#define HTTP_TEST_SERVER_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "goo/gtypes.h"
+
+class GooString;
+
+//------------------------------------------------------------------------
+
+enum HttpTestServerMode {
+  httpTestMultiRange,		// several ranges are sent as
+				//   multipart/byteranges
+  httpTestSingleRange,		// only the first range of a request is
+				//   sent
+  httpTestFull			// ranges are ignored: 200 with the whole
+				//   file
+};
+
+//------------------------------------------------------------------------
+// HttpTestServer
+//
+// Serves the files below a directory from its own threads, one per
+// connection, with keep-alive.  Latency and bandwidth can be limited to
+// model a remote server, and the server counts what it was asked for.
+//------------------------------------------------------------------------
+
+class HttpTestServer {
+public:
+
+  // Serve the files below <rootA>.  Takes <rootA>.
+  HttpTestServer(GooString *rootA);
+  ~HttpTestServer();
+
+  // Start listening on a free port of 127.0.0.1.  Returns false on
+  // failure.
+  GBool start();
+
+  // Stop listening and wait for the open connections to finish.
+  void stop();
+
+  int getPort() { return port; }
+
+  // URL of <path>, which is relative to the root.  The caller deletes
+  // the string.
+  GooString *getURL(const char *path);
+
+  // The settings may be changed while the server is running; they
+  // apply to the next request.
+  void setMode(HttpTestServerMode modeA) { mode = modeA; }
+  // HEAD requests are answered with 405 if this is false.
+  void setHeadAllowed(GBool headAllowedA) { headAllowed = headAllowedA; }
+  // Delay before every response, in milliseconds.
+  void setLatency(int latencyA) { latency = latencyA; }
+  // Bytes per second per connection, 0 for no limit.
+  void setBandwidth(int bandwidthA) { bandwidth = bandwidthA; }
+
+  // Requests answered, connections accepted and body bytes sent since
+  // the last resetStats().
+  int getRequests();
+  int getConnections();
+  size_t getBytesSent();
+  void resetStats();
+
+private:
+
+  static void *acceptThread(void *data);
+  static void *connectionThread(void *data);
+  void serveConnection(int fd);
+  GBool handleRequest(int fd, GooString *request);
+  void sendResponse(int fd, int code, GooString *headers);
+  GBool sendData(int fd, const char *data, size_t len);
+  GBool sendFileRange(int fd, FILE *f, size_t start, size_t end);
+  void countBytes(size_t n);
+
+  GooString *root;
+  HttpTestServerMode mode;
+  GBool headAllowed;
+  int latency;
+  int bandwidth;
+
+  int listenFd;
+  int port;
+  GBool running;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t idleCond;	// signalled when a connection ends
+  int nOpen;			// connections being served
+
+  int requests;
+  int connections;
+  size_t bytesSent;
+};
+
+#endif
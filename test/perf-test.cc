@@ -56,6 +56,10 @@
 #include "TextOutputDev.h"
 #include "PDFDoc.h"
 #include "Link.h"
+#ifdef ENABLE_LIBCURL
+#include "http-test-server.h"
+#include <unistd.h>
+#endif
 
 #ifdef _MSC_VER
 #define strdup _strdup
@@ -123,6 +127,10 @@ static StrList *gArgsListRoot = NULL;
 #define LOAD_ONLY_ARG       "-loadonly"
 #define PAGE_ARG            "-page"
 #define TEXT_ARG            "-text"
+#define HTTP_ARG            "-http"
+#define LATENCY_ARG         "-latency"
+#define BANDWIDTH_ARG       "-bandwidth"
+#define SERVER_MODE_ARG     "-servermode"
 
 /* Should we record timings? True if -timings command-line argument was given. */
 static bool gfTimings = false;
@@ -173,6 +181,28 @@ static int  gPageNo = PAGE_NO_NOT_GIVEN;
    profiling load time */
 static bool gfLoadOnly = false;
 
+/* If true, files are loaded over HTTP from a server on the loopback
+   interface, and the requests and bytes it served are reported along with
+   the time to the first page. Controlled by -http, -latency (milliseconds
+   per request), -bandwidth (bytes per second) and -servermode (multi,
+   single or full) command-line arguments */
+static bool gfHttp = false;
+static int  gHttpLatency = 0;
+static int  gHttpBandwidth = 0;
+static int  gHttpServerMode = 0;
+
+/* Load time plus the time it took to render the first page, of the file
+   that was rendered last */
+static double gFirstPageTimeInMs = 0;
+
+#ifdef ENABLE_LIBCURL
+static HttpTestServer * gHttpServer = NULL;
+static int      gHttpFiles = 0;
+static int      gHttpRequests = 0;
+static double   gHttpBytes = 0;
+static double   gHttpFirstPageTimeInMs = 0;
+#endif
+
 #define PDF_FILE_DPI 72
 
 #define MAX_FILENAME_SIZE 1024
@@ -293,6 +323,17 @@ bool str_endswith(const char *txt, const char *end)
     return false;
 }
 
+/* GooTimer::getElapsed() is in seconds, except where it is implemented
+   with QueryPerformanceCounter */
+double ElapsedMs(GooTimer *timer)
+{
+#if !defined(HAVE_GETTIMEOFDAY) && defined(_MSC_VER)
+    return timer->getElapsed();
+#else
+    return timer->getElapsed() * 1000.0;
+#endif
+}
+
 /* TODO: probably should move to some other file and change name to
    sleep_milliseconds */
 void sleep_milliseconds(int milliseconds)
@@ -810,7 +851,7 @@ void LogInfo(char *fmt, ...)
 
 static void PrintUsageAndExit(int argc, char **argv)
 {
-    printf("Usage: pdftest [-preview|-slowpreview] [-loadonly] [-timings] [-text] [-resolution NxM] [-recursive] [-page N] [-out out.txt] pdf-files-to-process\n");
+    printf("Usage: pdftest [-preview|-slowpreview] [-loadonly] [-timings] [-text] [-resolution NxM] [-recursive] [-page N] [-out out.txt] [-http] [-latency ms] [-bandwidth bytes/s] [-servermode multi|single|full] pdf-files-to-process\n");
     for (int i=0; i < argc; i++) {
         printf("i=%d, '%s'\n", i, argv[i]);
     }
@@ -831,6 +872,7 @@ static void RenderPdfAsText(const char *fileName)
     GooString *         txt = NULL;
     int                 pageCount;
     double              timeInMs;
+    bool                firstPage = false;
 
     assert(fileName);
     if (!fileName)
@@ -857,8 +899,10 @@ static void RenderPdfAsText(const char *fileName)
     }
 
     msTimer.stop();
-    timeInMs = msTimer.getElapsed();
+    timeInMs = ElapsedMs(&msTimer);
     LogInfo("load: %.2f ms\n", timeInMs);
+    gFirstPageTimeInMs = timeInMs;
+    firstPage = true;
 
     pageCount = pdfDoc->getNumPages();
     LogInfo("page count: %d\n", pageCount);
@@ -875,7 +919,11 @@ static void RenderPdfAsText(const char *fileName)
         pdfDoc->displayPage(textOut, curPage, 72, 72, rotate, useMediaBox, crop, doLinks);
         txt = textOut->getText(0.0, 0.0, 10000.0, 10000.0);
         msTimer.stop();
-        timeInMs = msTimer.getElapsed();
+        timeInMs = ElapsedMs(&msTimer);
+        if (firstPage) {
+            gFirstPageTimeInMs += timeInMs;
+            firstPage = false;
+        }
         if (gfTimings)
             LogInfo("page %d: %.2f ms\n", curPage, timeInMs);
         printf("%s\n", txt->getCString());
@@ -901,6 +949,7 @@ static void RenderPdf(const char *fileName)
     PdfEnginePoppler *  engineSplash = NULL;
     int                 pageCount;
     double              timeInMs;
+    bool                firstPage;
 
 #ifdef COPY_FILE
     // TODO: fails if file already exists and has read-only attribute
@@ -919,8 +968,10 @@ static void RenderPdf(const char *fileName)
         goto Error;
     }
     msTimer.stop();
-    timeInMs = msTimer.getElapsed();
+    timeInMs = ElapsedMs(&msTimer);
     LogInfo("load splash: %.2f ms\n", timeInMs);
+    gFirstPageTimeInMs = timeInMs;
+    firstPage = true;
     pageCount = engineSplash->pageCount();
 
     LogInfo("page count: %d\n", pageCount);
@@ -936,7 +987,11 @@ static void RenderPdf(const char *fileName)
         GooTimer msTimer;
         bmpSplash = engineSplash->renderBitmap(curPage, 100.0, 0);
         msTimer.stop();
-        double timeInMs = msTimer.getElapsed();
+        double timeInMs = ElapsedMs(&msTimer);
+        if (firstPage) {
+            gFirstPageTimeInMs += timeInMs;
+            firstPage = false;
+        }
         if (gfTimings) {
             if (!bmpSplash)
                 LogInfo("page splash %d: failed to render\n", curPage);
@@ -956,8 +1011,62 @@ Error:
     LogInfo("finished: %s\n", fileName);
 }
 
+#ifdef ENABLE_LIBCURL
+/* Load 'fileName' from the loopback server and report what it took */
+static void RenderFileOverHttp(const char *fileName)
+{
+    char        cwd[MAX_FILENAME_SIZE];
+    GooString * path;
+    GooString * url;
+
+    if (!gHttpServer) {
+        gHttpServer = new HttpTestServer(new GooString());
+        gHttpServer->setMode((HttpTestServerMode)gHttpServerMode);
+        gHttpServer->setLatency(gHttpLatency);
+        gHttpServer->setBandwidth(gHttpBandwidth);
+        if (!gHttpServer->start()) {
+            LogInfo("failed to start the http server\n");
+            delete gHttpServer;
+            gHttpServer = NULL;
+            return;
+        }
+    }
+
+    /* the server's root is the file system root */
+    if (DIR_SEP_CHAR == fileName[0] || !getcwd(cwd, sizeof(cwd)))
+        path = new GooString(fileName);
+    else
+        path = GooString::format("{0:s}" DIR_SEP_STR "{1:s}", cwd, fileName);
+    url = gHttpServer->getURL(path->getCString());
+    delete path;
+
+    gHttpServer->resetStats();
+    gFirstPageTimeInMs = 0;
+    if (gfTextOnly)
+        RenderPdfAsText(url->getCString());
+    else
+        RenderPdf(url->getCString());
+    delete url;
+
+    LogInfo("http: %d requests, %d connections, %.0f bytes, first page: %.2f ms\n",
+        gHttpServer->getRequests(), gHttpServer->getConnections(),
+        (double)gHttpServer->getBytesSent(), gFirstPageTimeInMs);
+    ++gHttpFiles;
+    gHttpRequests += gHttpServer->getRequests();
+    gHttpBytes += (double)gHttpServer->getBytesSent();
+    gHttpFirstPageTimeInMs += gFirstPageTimeInMs;
+}
+#endif
+
 static void RenderFile(const char *fileName)
 {
+#ifdef ENABLE_LIBCURL
+    if (gfHttp) {
+        RenderFileOverHttp(fileName);
+        return;
+    }
+#endif
+
     if (gfTextOnly) {
         RenderPdfAsText(fileName);
         return;
@@ -1061,6 +1170,32 @@ static void ParseCommandLine(int argc, char **argv)
                 gfSlowPreview = true;
             } else if (str_ieq(arg, LOAD_ONLY_ARG)) {
                 gfLoadOnly = true;
+            } else if (str_ieq(arg, HTTP_ARG)) {
+                gfHttp = true;
+            } else if (str_ieq(arg, LATENCY_ARG)) {
+                /* expect an integer after that */
+                ++i;
+                if (i == argc)
+                    PrintUsageAndExit(argc, argv);
+                gHttpLatency = atoi(argv[i]);
+            } else if (str_ieq(arg, BANDWIDTH_ARG)) {
+                /* expect an integer after that */
+                ++i;
+                if (i == argc)
+                    PrintUsageAndExit(argc, argv);
+                gHttpBandwidth = atoi(argv[i]);
+            } else if (str_ieq(arg, SERVER_MODE_ARG)) {
+                ++i;
+                if (i == argc)
+                    PrintUsageAndExit(argc, argv);
+                if (str_ieq(argv[i], "multi"))
+                    gHttpServerMode = 0;
+                else if (str_ieq(argv[i], "single"))
+                    gHttpServerMode = 1;
+                else if (str_ieq(argv[i], "full"))
+                    gHttpServerMode = 2;
+                else
+                    PrintUsageAndExit(argc, argv);
             } else if (str_ieq(arg, PAGE_ARG)) {
                 /* expect an integer after that */
                 ++i;
@@ -1266,6 +1401,14 @@ int main(int argc, char **argv)
         RenderCmdLineArg(curr->str);
         curr = curr->next;
     }
+#ifdef ENABLE_LIBCURL
+    if (gHttpServer) {
+        if (gHttpFiles > 0)
+            LogInfo("http total: %d files, %d requests, %.0f bytes, average first page: %.2f ms\n",
+                gHttpFiles, gHttpRequests, gHttpBytes, gHttpFirstPageTimeInMs / gHttpFiles);
+        delete gHttpServer;
+    }
+#endif
     if (outFile)
         fclose(outFile);
     PreviewBitmapDestroy();
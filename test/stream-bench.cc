@@ -0,0 +1,253 @@
+//========================================================================
+//
+// stream-bench.cc
+//
+// Times reading every stream of a PDF file one char at a time with
+// getChar() against reading it in blocks with getChars(), and checks
+// that both return the same data.  Also times decoding the images row
+// by row through ImageStream, and lexing the page content streams.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
+#include "XRef.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Catalog.h"
+#include "Page.h"
+#include "PDFDoc.h"
+
+#define blockSize 4096
+
+struct Totals {
+  double bytes;			// decoded bytes read
+  Guint sum;			// checksum of the decoded bytes
+};
+
+static void addChars(Totals *t, Guchar *buf, int n) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    t->sum = t->sum * 31 + buf[i];
+  }
+  t->bytes += n;
+}
+
+// Read every stream in the file, through its filters.
+static double readStreams(XRef *xref, GBool blocks, Totals *t) {
+  Object obj;
+  Stream *str;
+  GooTimer timer;
+  Guchar buf[blockSize];
+  XRefEntry *e;
+  int i, c, n;
+
+  t->bytes = 0;
+  t->sum = 0;
+  timer.start();
+  for (i = 0; i < xref->getNumObjects(); ++i) {
+    e = xref->getEntry(i);
+    if (e->type == xrefEntryFree) {
+      continue;
+    }
+    if (!xref->fetch(i, e->type == xrefEntryCompressed ? 0 : e->gen,
+		     &obj)->isStream()) {
+      obj.free();
+      continue;
+    }
+    str = obj.getStream();
+    str->reset();
+    if (blocks) {
+      while ((n = str->getChars(blockSize, buf)) > 0) {
+	addChars(t, buf, n);
+      }
+    } else {
+      while ((c = str->getChar()) != EOF) {
+	buf[0] = (Guchar)c;
+	addChars(t, buf, 1);
+      }
+    }
+    str->close();
+    obj.free();
+  }
+  timer.stop();
+  return timer.getElapsed();
+}
+
+// Decode every image XObject through ImageStream::getLine(), the way
+// the output devices do.
+static double readImages(XRef *xref, Totals *t) {
+  Object obj, obj1;
+  Dict *dict;
+  ImageStream *imgStr;
+  GooTimer timer;
+  Guchar *line;
+  XRefEntry *e;
+  int i, y, width, height, nComps, nBits;
+
+  t->bytes = 0;
+  t->sum = 0;
+  timer.start();
+  for (i = 0; i < xref->getNumObjects(); ++i) {
+    e = xref->getEntry(i);
+    if (e->type == xrefEntryFree) {
+      continue;
+    }
+    if (!xref->fetch(i, e->type == xrefEntryCompressed ? 0 : e->gen,
+		     &obj)->isStream()) {
+      obj.free();
+      continue;
+    }
+    dict = obj.streamGetDict();
+    if (!dict->lookup("Subtype", &obj1)->isName("Image")) {
+      obj1.free();
+      obj.free();
+      continue;
+    }
+    obj1.free();
+    width = dict->lookup("Width", &obj1)->isInt() ? obj1.getInt() : 0;
+    obj1.free();
+    height = dict->lookup("Height", &obj1)->isInt() ? obj1.getInt() : 0;
+    obj1.free();
+    if (dict->lookup("ImageMask", &obj1)->isBool() && obj1.getBool()) {
+      nComps = 1;
+      nBits = 1;
+    } else {
+      nBits = dict->lookup("BitsPerComponent", &obj1)->isInt()
+	        ? obj1.getInt() : 8;
+      obj1.free();
+      dict->lookup("ColorSpace", &obj1);
+      nComps = obj1.isName("DeviceRGB") ? 3
+	       : obj1.isName("DeviceCMYK") ? 4 : 1;
+    }
+    obj1.free();
+    if (width <= 0 || height <= 0) {
+      obj.free();
+      continue;
+    }
+    imgStr = new ImageStream(obj.getStream(), width, nComps, nBits);
+    imgStr->reset();
+    for (y = 0; y < height; ++y) {
+      if (!(line = imgStr->getLine())) {
+	break;
+      }
+      addChars(t, line, width * nComps);
+    }
+    imgStr->close();
+    delete imgStr;
+    obj.free();
+  }
+  timer.stop();
+  return timer.getElapsed();
+}
+
+// Run the content streams of all pages through the lexer.  In-line
+// image data is skipped the way Gfx does it.
+static double lexPages(PDFDoc *doc, double *nTokens) {
+  Object contents, obj;
+  Parser *parser;
+  Stream *str;
+  GooTimer timer;
+  int pg, c1, c2;
+
+  *nTokens = 0;
+  timer.start();
+  for (pg = 1; pg <= doc->getNumPages(); ++pg) {
+    doc->getCatalog()->getPage(pg)->getContents(&contents);
+    if (contents.isArray() || contents.isStream()) {
+      parser = new Parser(doc->getXRef(),
+			  new Lexer(doc->getXRef(), &contents), gFalse);
+      while (!parser->getObj(&obj)->isEOF()) {
+	*nTokens += 1;
+	if (obj.isCmd("ID")) {
+	  str = parser->getStream();
+	  c1 = str->getChar();
+	  c2 = str->getChar();
+	  while (!(c1 == 'E' && c2 == 'I') && c2 != EOF) {
+	    c1 = c2;
+	    c2 = str->getChar();
+	  }
+	}
+	obj.free();
+      }
+      obj.free();
+      delete parser;
+    }
+    contents.free();
+  }
+  timer.stop();
+  return timer.getElapsed();
+}
+
+int main(int argc, char *argv[]) {
+  PDFDoc *doc;
+  Totals tChar, tBlock, tImg;
+  double t, tGetChar, tGetChars, tImages, tLex, nTokens;
+  int passes, i;
+  GBool ok;
+
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: stream-bench file.pdf [passes]\n");
+    return 1;
+  }
+  passes = argc > 2 ? atoi(argv[2]) : 5;
+  if (passes <= 0) {
+    fprintf(stderr, "stream-bench: bad arguments\n");
+    return 1;
+  }
+  globalParams = new GlobalParams();
+  doc = new PDFDoc(new GooString(argv[1]));
+  if (!doc->isOk()) {
+    fprintf(stderr, "stream-bench: couldn't open %s\n", argv[1]);
+    delete doc;
+    delete globalParams;
+    return 1;
+  }
+
+  // best of <passes>, so that everything is cached after the first one
+  tGetChar = tGetChars = tImages = tLex = 0;
+  for (i = 0; i < passes; ++i) {
+    t = readStreams(doc->getXRef(), gFalse, &tChar);
+    if (i == 0 || t < tGetChar) {
+      tGetChar = t;
+    }
+    t = readStreams(doc->getXRef(), gTrue, &tBlock);
+    if (i == 0 || t < tGetChars) {
+      tGetChars = t;
+    }
+    t = readImages(doc->getXRef(), &tImg);
+    if (i == 0 || t < tImages) {
+      tImages = t;
+    }
+    t = lexPages(doc, &nTokens);
+    if (i == 0 || t < tLex) {
+      tLex = t;
+    }
+  }
+  ok = tChar.bytes == tBlock.bytes && tChar.sum == tBlock.sum;
+
+  printf("streams   %10.0f bytes   getChar %8.3f ms   getChars %8.3f ms"
+	 "  (%.1fx)  %s\n",
+	 tBlock.bytes, tGetChar * 1000, tGetChars * 1000,
+	 tGetChars > 0 ? tGetChar / tGetChars : 0.0, ok ? "ok" : "MISMATCH");
+  printf("images    %10.0f bytes   getLine %8.3f ms\n",
+	 tImg.bytes, tImages * 1000);
+  printf("content   %10.0f tokens  lexer   %8.3f ms\n",
+	 nTokens, tLex * 1000);
+
+  delete doc;
+  delete globalParams;
+  return ok ? 0 : 1;
+}
@@ -47,6 +47,7 @@
 #include "PDFDocEncoding.h"
 #include "Error.h"
 #include "DateInfo.h"
+#include "NetStats.h"
 
 static void printInfoString(Dict *infoDict, char *key, char *text,
 			    UnicodeMap *uMap);
@@ -57,6 +58,7 @@ static int firstPage = 1;
 static int lastPage = 0;
 static GBool printBoxes = gFalse;
 static GBool printMetadata = gFalse;
+static GBool printNetStats = gFalse;
 static char textEncName[128] = "";
 static char ownerPassword[33] = "\001";
 static char userPassword[33] = "\001";
@@ -73,6 +75,8 @@ static const ArgDesc argDesc[] = {
    "print the page bounding boxes"},
   {"-meta",   argFlag,     &printMetadata,    0,
    "print the document metadata (XML)"},
+  {"-netstats", argFlag,   &printNetStats,    0,
+   "print the network traffic of a remote document"},
   {"-enc",    argString,   textEncName,    sizeof(textEncName),
    "output text encoding name"},
   {"-listenc",argFlag,     &printEnc,      0,
@@ -105,6 +109,7 @@ int main(int argc, char *argv[]) {
   double w, h, wISO, hISO;
   FILE *f;
   GooString *metadata;
+  NetStats netStats;
   GBool ok;
   int exitCode;
   int pg, i;
@@ -313,6 +318,11 @@ int main(int argc, char *argv[]) {
     delete metadata;
   }
 
+  // print the network traffic
+  if (printNetStats && doc->getNetStats(&netStats)) {
+    netStats.print(stdout);
+  }
+
   exitCode = 0;
 
   // clean up
@@ -39,6 +39,7 @@
 #include "splash/SplashBitmap.h"
 #include "splash/Splash.h"
 #include "SplashOutputDev.h"
+#include "NetStats.h"
 
 #define PPM_FILE_SZ 512
 
@@ -66,6 +67,7 @@ static char vectorAntialiasStr[16] = "";
 static char ownerPassword[33] = "";
 static char userPassword[33] = "";
 static GBool quiet = gFalse;
+static GBool printNetStats = gFalse;
 static GBool printVersion = gFalse;
 static GBool printHelp = gFalse;
 
@@ -130,6 +132,8 @@ static const ArgDesc argDesc[] = {
   
   {"-q",      argFlag,     &quiet,         0,
    "don't print any messages or errors"},
+  {"-netstats", argFlag,   &printNetStats, 0,
+   "print the network traffic of a remote document to stderr"},
   {"-v",      argFlag,     &printVersion,  0,
    "print copyright and version info"},
   {"-h",      argFlag,     &printHelp,     0,
@@ -188,6 +192,7 @@ int main(int argc, char *argv[]) {
   GooString *ownerPW, *userPW;
   SplashColor paperColor;
   SplashOutputDev *splashOut;
+  NetStats netStats;
   GBool ok;
   int exitCode;
   int pg, pg_num_len;
@@ -324,6 +329,10 @@ int main(int argc, char *argv[]) {
   }
   delete splashOut;
 
+  if (printNetStats && doc->getNetStats(&netStats)) {
+    netStats.print(stderr);
+  }
+
   exitCode = 0;
 
   // clean up